@@ -0,0 +1,168 @@
+#include "CLI11.h"
+#include <squeeze.h>
+#include <chrono>
+#include <cstddef>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Compares the string matchers on the same inputs. All matchers are configured with the LZ80 match
+// classes and driven by the same greedy LzCompressor, so the only difference is the match finder.
+
+struct Result
+{
+    size_t compressedSize{0};
+    std::chrono::high_resolution_clock::duration duration{};
+};
+
+// Processor that only accounts for the size an LZ80 stream would have.
+class Lz80SizeEstimator
+{
+public:
+    void consumeMatch(const uint8_t*, const uint8_t*, const squeeze::Match& match)
+    {
+        flushLiterals();
+        m_size += match.cls + 1;
+    }
+
+    void consumeLiteral(const uint8_t*)
+    {
+        if (++m_literals == 0x80bf)
+        {
+            flushLiterals();
+        }
+    }
+
+    auto finish() -> size_t
+    {
+        flushLiterals();
+        return m_size + 3;
+    }
+
+private:
+    void flushLiterals()
+    {
+        if (m_literals > 0)
+        {
+            m_size += m_literals + (m_literals < 0x40 ? 1 : (m_literals < 0xc0 ? 2 : 3));
+            m_literals = 0;
+        }
+    }
+
+    size_t m_size{0};
+    size_t m_literals{0};
+};
+
+template <class Matcher> void configureLz80(Matcher& matcher, const size_t windowSize)
+{
+    matcher.configureMatchClass(0, squeeze::MatchClass{0, {2, 5}, {1, 16}});
+    matcher.configureMatchClass(1, squeeze::MatchClass{1, {3, 18}, {1, 1024}});
+    matcher.configureMatchClass(2, squeeze::MatchClass{2, {4, 131}, {1, windowSize}});
+}
+
+template <class Matcher>
+auto run(const std::vector<uint8_t>& input, const size_t windowSize,
+         const squeeze::ParseOptions& options, Matcher&& matcher) -> Result
+{
+    squeeze::LzCompressor<Matcher> lz{options, std::forward<Matcher>(matcher)};
+    configureLz80(lz.matcher(), windowSize);
+
+    Lz80SizeEstimator estimator;
+    auto const start = std::chrono::high_resolution_clock::now();
+    lz.compress(input.data(), input.size(), estimator);
+    auto const end = std::chrono::high_resolution_clock::now();
+    return Result{estimator.finish(), end - start};
+}
+
+void report(const std::string& name, const size_t inputSize, const Result& result)
+{
+    auto const seconds = std::chrono::duration<double>(result.duration).count();
+    auto const ms = seconds * 1000.0;
+    auto const throughput = static_cast<double>(inputSize) / (1024.0 * 1024.0) / seconds;
+    auto const ratio =
+        100.0 * static_cast<double>(result.compressedSize) / static_cast<double>(inputSize);
+    std::cout << "  " << std::left << std::setw(30) << name << std::right << std::fixed
+              << std::setprecision(1) << std::setw(10) << ms << " ms" << std::setw(9) << throughput
+              << " MiB/s" << std::setw(11) << result.compressedSize << " bytes" << std::setw(7)
+              << ratio << "%\n";
+}
+
+auto readFile(const std::filesystem::path& path) -> std::vector<uint8_t>
+{
+    std::ifstream input{path, std::ifstream::binary};
+    std::vector<uint8_t> buffer(std::filesystem::file_size(path));
+    input.read(reinterpret_cast<char*>(buffer.data()), buffer.size());
+    return buffer;
+}
+
+int main(int argc, char* argv[])
+{
+    CLI::App app{"squeeze-benchmark"};
+
+    std::vector<std::filesystem::path> inputs;
+    size_t windowSize{32768};
+    app.add_option("-w,--window", windowSize, "window size of the LZ80 match classes");
+    squeeze::ParseOptions options;
+    app.add_option("-t,--threads", options.threads,
+                   "threads searching matches ahead of the parse (0: all cores)");
+    app.add_option("inputs", inputs, "PATHs to input files")
+        ->required()
+        ->check(CLI::ExistingFile);
+
+    CLI11_PARSE(app, argc, argv);
+
+    for (auto const& path : inputs)
+    {
+        auto const input = readFile(path);
+        std::cout << path.string() << " (" << input.size() << " bytes)\n";
+        if (input.empty())
+        {
+            continue;
+        }
+
+        report("BinaryTreeMatcher", input.size(),
+               run(input, windowSize, options, squeeze::BinaryTreeMatcher<3>{windowSize}));
+        report("BinaryTreeMatcher (2 bytes)", input.size(),
+               run(input, windowSize, options, squeeze::BinaryTreeMatcher<3, 2>{windowSize}));
+        report("BinaryTreeMatcher (3 bytes)", input.size(),
+               run(input, windowSize, options, squeeze::BinaryTreeMatcher<3, 3>{windowSize}));
+        squeeze::BinaryTreeMatcher<3, 2> fused{windowSize};
+        fused.setFusedInsertion(true);
+        report("BinaryTreeMatcher (2, fused)", input.size(),
+               run(input, windowSize, options, std::move(fused)));
+        squeeze::BinaryTreeMatcher<3, 2, unsigned int, 8> keyed{windowSize};
+        keyed.setFusedInsertion(true);
+        report("BinaryTreeMatcher (2, keys)", input.size(),
+               run(input, windowSize, options, std::move(keyed)));
+        if (windowSize < 0xfffe)
+        {
+            squeeze::BinaryTreeMatcher<3, 2, uint16_t> compact{windowSize};
+            compact.setFusedInsertion(true);
+            report("BinaryTreeMatcher (2, 16 bit)", input.size(),
+                   run(input, windowSize, options, std::move(compact)));
+            squeeze::BinaryTreeMatcher<3, 2, uint16_t, 8> compactKeyed{windowSize};
+            compactKeyed.setFusedInsertion(true);
+            report("BinaryTreeMatcher (2, 16, keys)", input.size(),
+                   run(input, windowSize, options, std::move(compactKeyed)));
+        }
+        squeeze::BinaryTreeMatcher<3, 2> sparse{windowSize};
+        sparse.setFusedInsertion(true);
+        sparse.setInsertionPolicy(squeeze::InsertionPolicy{.fullLength = 32, .stride = 8});
+        report("BinaryTreeMatcher (2, sparse)", input.size(),
+               run(input, windowSize, options, std::move(sparse)));
+        report("SuffixArrayMatcher", input.size(),
+               run(input, windowSize, options, squeeze::SuffixArrayMatcher<3>{windowSize}));
+        report("HashChainMatcher (15, 16)", input.size(),
+               run(input, windowSize, options, squeeze::HashChainMatcher<3>{windowSize, 15, 16}));
+        report("HashChainMatcher (15, 64)", input.size(),
+               run(input, windowSize, options, squeeze::HashChainMatcher<3>{windowSize, 15, 64}));
+        report("HashChainMatcher (16, 256)", input.size(),
+               run(input, windowSize, options, squeeze::HashChainMatcher<3>{windowSize, 16, 256}));
+    }
+
+    return EXIT_SUCCESS;
+}
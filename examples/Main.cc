@@ -7,6 +7,7 @@
 #include <filesystem>
 #include <fstream>
 #include <iomanip>
+#include <span>
 #include <sstream>
 #include <vector>
 
@@ -28,6 +29,8 @@ struct Arguments
 {
     Compression type;
     Action action{Action::Decompress};
+    squeeze::CompressionLevel level{squeeze::CompressionLevel::Normal};
+    unsigned int threads{1};
     std::filesystem::path input;
     std::filesystem::path output;
 };
@@ -42,33 +45,33 @@ auto openInput(const Arguments& arguments) -> std::vector<uint8_t>
     return inputBuffer;
 }
 
-void writeOutput(const std::filesystem::path& path, const std::vector<uint8_t>& data)
+void writeOutput(const std::filesystem::path& path, const std::span<const uint8_t> data)
 {
     std::ofstream output{path, std::ofstream::binary};
     output.write(reinterpret_cast<const char*>(data.data()), data.size());
     output.close();
 }
 
-void writeOutput(const Arguments& arguments, const std::vector<uint8_t>& data)
+void writeOutput(const Arguments& arguments, const std::span<const uint8_t> data)
 {
     writeOutput(arguments.output, data);
 }
 
 auto doDecompression(const Compression type, const std::vector<uint8_t>& compressed)
-    -> std::pair<std::vector<uint8_t>, std::chrono::high_resolution_clock::duration>
+    -> std::pair<squeeze::ByteVector, std::chrono::high_resolution_clock::duration>
 {
-    std::vector<uint8_t> decompressed;
+    squeeze::ByteVector decompressed;
     auto const start = std::chrono::high_resolution_clock::now();
     switch (type)
     {
     case Compression::NamcoLz80:
-        decompressed = squeeze::decompressLz80(compressed.data(), compressed.size());
+        squeeze::decompressLz80(compressed.data(), compressed.size(), decompressed);
         break;
     case Compression::NamcoLz01:
-        decompressed = squeeze::decompressLz01(compressed.data(), compressed.size());
+        squeeze::decompressLz01(compressed.data(), compressed.size(), decompressed);
         break;
     case Compression::NamcoLz03:
-        decompressed = squeeze::decompressLz03(compressed.data(), compressed.size());
+        squeeze::decompressLz03(compressed.data(), compressed.size(), decompressed);
         break;
     default: throw std::runtime_error{"decompression type not supported"};
     }
@@ -76,7 +79,8 @@ auto doDecompression(const Compression type, const std::vector<uint8_t>& compres
     return std::make_pair(std::move(decompressed), end - start);
 }
 
-auto doCompression(const Compression type, const std::vector<uint8_t>& decompressed)
+auto doCompression(const Compression type, const squeeze::CompressionLevel level,
+                   const unsigned int threads, const std::vector<uint8_t>& decompressed)
     -> std::pair<std::vector<uint8_t>, std::chrono::high_resolution_clock::duration>
 {
     std::vector<uint8_t> compressed;
@@ -84,13 +88,16 @@ auto doCompression(const Compression type, const std::vector<uint8_t>& decompres
     switch (type)
     {
     case Compression::NamcoLz80:
-        compressed = squeeze::compressLz80(decompressed.data(), decompressed.size());
+        compressed = squeeze::compressLz80(decompressed.data(), decompressed.size(), 32768, level,
+                                           threads);
         break;
     case Compression::NamcoLz01:
-        compressed = squeeze::compressLz01(decompressed.data(), decompressed.size());
+        compressed =
+            squeeze::compressLz01(decompressed.data(), decompressed.size(), level, threads);
         break;
     case Compression::NamcoLz03:
-        compressed = squeeze::compressLz03(decompressed.data(), decompressed.size());
+        compressed =
+            squeeze::compressLz03(decompressed.data(), decompressed.size(), level, threads);
         break;
     default: throw std::runtime_error{"decompression type not supported"};
     }
@@ -136,7 +143,7 @@ void decompress(const Arguments& arguments)
 void compress(const Arguments& arguments)
 {
     auto const input = openInput(arguments);
-    auto const [compressed, duration] = doCompression(arguments.type, input);
+    auto const [compressed, duration] = doCompression(arguments.type, arguments.level, arguments.threads, input);
     writeOutput(arguments, compressed);
     std::cout << "Compressing took " << formatDuration(duration) << "\n";
 }
@@ -144,7 +151,8 @@ void compress(const Arguments& arguments)
 void verify(const Arguments& arguments)
 {
     auto const input = openInput(arguments);
-    auto const [compressed, compressionDuration] = doCompression(arguments.type, input);
+    auto const [compressed, compressionDuration] =
+        doCompression(arguments.type, arguments.level, arguments.threads, input);
     auto const [decompressed, decompressionDuration] = doDecompression(arguments.type, compressed);
 
     std::cout << "Compressing took " << formatDuration(compressionDuration) << "\n";
@@ -196,9 +204,19 @@ int main(int argc, char* argv[])
         {"lz03", Compression::NamcoLz03},
     };
 
+    std::map<std::string, squeeze::CompressionLevel> levels{
+        {"fast", squeeze::CompressionLevel::Fast},
+        {"normal", squeeze::CompressionLevel::Normal},
+        {"maximum", squeeze::CompressionLevel::Maximum},
+    };
+
     compressCmd->add_option("-t,--type", arguments.type, "type of compression")
         ->required()
         ->transform(CLI::CheckedTransformer(compressions, CLI::ignore_case));
+    compressCmd->add_option("-l,--level", arguments.level, "compression level")
+        ->transform(CLI::CheckedTransformer(levels, CLI::ignore_case));
+    compressCmd->add_option("-j,--threads", arguments.threads,
+                            "compress blocks in parallel on this many threads (0: all cores)");
     compressCmd->add_option("-o,--output", arguments.output, "PATH to output file")->required();
     compressCmd->add_option("input", arguments.input, "PATH to input file")
         ->required()
@@ -215,6 +233,10 @@ int main(int argc, char* argv[])
     verifyCmd->add_option("-t,--type", arguments.type, "type of compression")
         ->required()
         ->transform(CLI::CheckedTransformer(compressions, CLI::ignore_case));
+    verifyCmd->add_option("-l,--level", arguments.level, "compression level")
+        ->transform(CLI::CheckedTransformer(levels, CLI::ignore_case));
+    verifyCmd->add_option("-j,--threads", arguments.threads,
+                          "compress blocks in parallel on this many threads (0: all cores)");
     verifyCmd->add_option("-o,--output", arguments.output, "PATH to output file")->required();
     verifyCmd->add_option("input", arguments.input, "PATH to input file")
         ->required()
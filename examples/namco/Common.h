@@ -0,0 +1,18 @@
+#pragma once
+
+#include <squeeze.h>
+
+namespace squeeze {
+
+// Trades compression speed for compression ratio.
+enum class CompressionLevel
+{
+    // hash chains with a short search and greedy parsing
+    Fast,
+    // binary tree search (one tree per prefix) and greedy parsing
+    Normal,
+    // exhaustive binary tree search and optimal parsing
+    Maximum,
+};
+
+} // namespace squeeze
@@ -1,154 +1,319 @@
 #include "Lz0103.h"
 #include "Lz0103Data.h"
+#include <bit>
 #include <squeeze.h>
 #include <stdexcept>
 
 namespace squeeze {
 
-class Lz0103Decompressor
+template <class Lzss> class Lz0103Decompressor
 {
 public:
-    explicit Lz0103Decompressor(bool rle);
-
-    [[nodiscard]] auto decompress(const uint8_t* data, const size_t size) -> std::vector<uint8_t>;
+    // longest token without literals copied from the input: control byte and three bytes of RLE
+    static constexpr size_t MaxTokenLength = 4;
+    // longest group of a control byte and its eight tokens
+    static constexpr size_t MaxGroupLength = 1 + 8 * 3;
+
+    template <class... Args>
+    explicit Lz0103Decompressor(bool rle, Args&&... lzssArgs);
+
+    // Returns what Lzss::finish() returns.
+    [[nodiscard]] decltype(auto) decompress(const uint8_t* data, const size_t size,
+                                            const size_t expectedSize = 0);
+
+    // Resets the state of the decoder, but not that of Lzss.
+    void reset();
+    void decodeToken();
+    // Decodes a control byte and all of its tokens, copying runs of literals at once. Requires
+    // MaxGroupLength bytes of input.
+    void decodeGroup();
+    // Decodes a match or run of the same byte, without the control bit.
+    void decodeReference();
 
     void emitLiterals(size_t length);
     void emitLiterals(size_t length, uint8_t value);
     void emitMatch(size_t offset, size_t length);
     void advance(size_t length);
 
+    auto lzss() -> Lzss&
+    {
+        return m_lzss;
+    }
+
 private:
     bool m_rle{false};
-    std::vector<uint8_t> m_preData;
+    // the ring buffer prefill, before the decompressed data
+    const uint8_t* m_preData{nullptr};
+    // position in the ring buffer of reference offset 0 at the start, modulo its size
     size_t m_zeroOffset;
+    // bytes decompressed so far
     size_t m_ringBufferOffset;
-    squeeze::LzDecompressor<true> m_lzss;
+    uint8_t m_control{0xff};
+    unsigned int m_bitsRemaining{0};
+    Lzss m_lzss;
 };
 
-Lz0103Decompressor::Lz0103Decompressor(bool rle)
+template <class Lzss>
+template <class... Args>
+Lz0103Decompressor<Lzss>::Lz0103Decompressor(bool rle, Args&&... lzssArgs)
     : m_rle{rle}
+    , m_preData{RingbufferPrefill + (rle ? 1 : 0)}
+    , m_lzss(std::forward<Args>(lzssArgs)...)
 {
-    m_preData.clear();
-    m_preData.resize(4096);
-    std::memcpy(m_preData.data(), RingbufferPrefill + (m_rle ? 1 : 0), 4096);
 }
 
-auto Lz0103Decompressor::decompress(const uint8_t* data, const size_t size) -> std::vector<uint8_t>
+template <class Lzss>
+decltype(auto) Lz0103Decompressor<Lzss>::decompress(const uint8_t* data, const size_t size,
+                                                    const size_t expectedSize)
+{
+    reset();
+    m_lzss.reset(data, size, m_preData, 4096, expectedSize);
+
+    while (m_lzss.canDecode(MaxTokenLength))
+    {
+        if (m_bitsRemaining == 0 && m_lzss.available() >= MaxGroupLength)
+        {
+            decodeGroup();
+        }
+        else
+        {
+            decodeToken();
+        }
+    }
+    return m_lzss.finish();
+}
+
+template <class Lzss> void Lz0103Decompressor<Lzss>::reset()
 {
     m_ringBufferOffset = 0;
     m_zeroOffset = 0x1000 - (m_rle ? 0xfef : 0xfee);
-    uint8_t control{0xff};
-    unsigned int bitsRemaining{0};
-    m_lzss.reset(data, size, m_preData.data(), m_preData.size());
+    m_control = 0xff;
+    m_bitsRemaining = 0;
+}
+
+template <class Lzss> void Lz0103Decompressor<Lzss>::decodeToken()
+{
+    if (m_bitsRemaining == 0)
+    {
+        m_control = m_lzss.fetch();
+        m_bitsRemaining = 8;
+    }
+    m_bitsRemaining -= 1;
 
-    while (!m_lzss.isAtEnd())
+    if (m_control & 1)
+    {
+        emitLiterals(1);
+    }
+    else
     {
-        if (bitsRemaining == 0)
+        decodeReference();
+    }
+    m_control >>= 1;
+}
+
+template <class Lzss> void Lz0103Decompressor<Lzss>::decodeGroup()
+{
+    unsigned int control = m_lzss.fetch();
+    unsigned int tokens = 8;
+    while (tokens > 0)
+    {
+        // the bits above the remaining tokens are 0, so the run ends with the group at the latest
+        auto const literals = static_cast<unsigned int>(std::countr_one(control));
+        if (literals > 0)
         {
-            control = m_lzss.fetch();
-            bitsRemaining = 8;
+            emitLiterals(literals);
+            control >>= literals;
+            tokens -= literals;
+            if (tokens == 0)
+            {
+                break;
+            }
         }
-        bitsRemaining -= 1;
+        decodeReference();
+        control >>= 1;
+        tokens -= 1;
+    }
+}
 
-        if (control & 1)
+template <class Lzss> void Lz0103Decompressor<Lzss>::decodeReference()
+{
+    auto const nextControl1 = m_lzss.fetch();
+    auto const nextControl2 = m_lzss.fetch();
+    const uint8_t control1 = nextControl2 & 0x0F;
+    const uint8_t control2 = nextControl2 >> 4;
+    if (m_rle && control1 == 0xF)
+    {
+        uint16_t runLength;
+        uint8_t value;
+        if (control2 == 0x0)
         {
-            emitLiterals(1);
+            runLength = nextControl1 + 19;
+            value = m_lzss.fetch();
         }
         else
         {
-            auto const nextControl1 = m_lzss.fetch();
-            auto const nextControl2 = m_lzss.fetch();
-            const uint8_t control1 = nextControl2 & 0x0F;
-            const uint8_t control2 = nextControl2 >> 4;
-            if (m_rle && control1 == 0xF)
-            {
-                uint16_t runLength;
-                uint8_t value;
-                if (control2 == 0x0)
-                {
-                    runLength = nextControl1 + 19;
-                    value = m_lzss.fetch();
-                }
-                else
-                {
-                    runLength = control2 + 3;
-                    value = nextControl1;
-                }
-                emitLiterals(runLength, value);
-            }
-            else
-            {
-                const uint16_t referenceLength = 3 + control1;
-                const uint16_t referenceOffset = nextControl1 | (control2 << 8);
-                auto const absoluteOffset =
-                    (m_zeroOffset + referenceOffset - m_ringBufferOffset) % 4096;
-                auto const offset = 4096 - absoluteOffset;
-                emitMatch(offset, referenceLength);
-            }
+            runLength = control2 + 3;
+            value = nextControl1;
         }
-        control >>= 1;
+        emitLiterals(runLength, value);
+    }
+    else
+    {
+        const uint16_t referenceLength = 3 + control1;
+        const uint16_t referenceOffset = nextControl1 | (control2 << 8);
+        // the ring buffer wraps around every 4096 bytes
+        auto const absoluteOffset = (m_zeroOffset + referenceOffset - m_ringBufferOffset) % 4096;
+        auto const offset = 4096 - absoluteOffset;
+        emitMatch(offset, referenceLength);
     }
-    auto decompressed = m_lzss.finish();
-    decompressed.erase(decompressed.begin(), decompressed.begin() + m_preData.size());
-    return decompressed;
 }
 
-void Lz0103Decompressor::emitLiterals(size_t length)
+template <class Lzss> void Lz0103Decompressor<Lzss>::emitLiterals(size_t length)
 {
     m_lzss.emitLiterals(length);
     advance(length);
 }
 
-void Lz0103Decompressor::emitLiterals(size_t length, uint8_t value)
+template <class Lzss> void Lz0103Decompressor<Lzss>::emitLiterals(size_t length, uint8_t value)
 {
     m_lzss.emitLiterals(length, value);
     advance(length);
 }
 
-void Lz0103Decompressor::emitMatch(size_t offset, size_t length)
+template <class Lzss> void Lz0103Decompressor<Lzss>::emitMatch(size_t offset, size_t length)
 {
     m_lzss.emitMatch(offset, length);
     advance(length);
 }
 
-void Lz0103Decompressor::advance(size_t length)
+template <class Lzss> void Lz0103Decompressor<Lzss>::advance(size_t length)
 {
     m_ringBufferOffset += length;
-    if (m_ringBufferOffset >= m_zeroOffset)
-    {
-        m_zeroOffset += 4096;
-    }
 }
 
-auto decompressLz01(const uint8_t* data, const size_t size) -> std::vector<uint8_t>
+auto decompressLz01(const uint8_t* data, const size_t size, const size_t expectedSize)
+    -> std::vector<uint8_t>
+{
+    Lz0103Decompressor<LzDecompressor<true>> lz{false};
+    return lz.decompress(data, size, expectedSize);
+}
+
+void decompressLz01(const uint8_t* data, const size_t size, ByteVector& output,
+                    const size_t expectedSize)
+{
+    Lz0103Decompressor<LzDecompressor<true, VectorOutput<ByteVector>>> lz{false};
+    output = lz.decompress(data, size, expectedSize);
+}
+
+auto decompressLz03(const uint8_t* data, const size_t size, const size_t expectedSize)
+    -> std::vector<uint8_t>
+{
+    Lz0103Decompressor<LzDecompressor<true>> lz{true};
+    return lz.decompress(data, size, expectedSize);
+}
+
+void decompressLz03(const uint8_t* data, const size_t size, ByteVector& output,
+                    const size_t expectedSize)
+{
+    Lz0103Decompressor<LzDecompressor<true, VectorOutput<ByteVector>>> lz{true};
+    output = lz.decompress(data, size, expectedSize);
+}
+
+auto decompressLz01(const uint8_t* data, const size_t size, uint8_t* output,
+                    const size_t capacity) -> size_t
 {
-    Lz0103Decompressor lz{false};
+    Lz0103Decompressor<LzDecompressor<true, BufferOutput>> lz{false, output, capacity};
     return lz.decompress(data, size);
 }
 
-auto decompressLz03(const uint8_t* data, const size_t size) -> std::vector<uint8_t>
+auto decompressLz03(const uint8_t* data, const size_t size, uint8_t* output,
+                    const size_t capacity) -> size_t
 {
-    Lz0103Decompressor lz{true};
+    Lz0103Decompressor<LzDecompressor<true, BufferOutput>> lz{true, output, capacity};
     return lz.decompress(data, size);
 }
 
-class Lz0103Compressor
+auto decompressedSizeLz01(const uint8_t* data, const size_t size) -> size_t
+{
+    Lz0103Decompressor<LzSizeScanner> lz{false};
+    return lz.decompress(data, size);
+}
+
+auto decompressedSizeLz03(const uint8_t* data, const size_t size) -> size_t
+{
+    Lz0103Decompressor<LzSizeScanner> lz{true};
+    return lz.decompress(data, size);
+}
+
+struct Lz0103StreamDecompressor::Impl
+{
+    Impl(const bool rle, std::function<void(const uint8_t* data, size_t size)> callback)
+        : decompressor{rle, 4096, std::move(callback)}
+    {
+        decompressor.reset();
+        decompressor.lzss().reset(RingbufferPrefill + (rle ? 1 : 0), 4096);
+    }
+
+    void decode()
+    {
+        auto& lzss = decompressor.lzss();
+        while (lzss.canDecode(decltype(decompressor)::MaxTokenLength))
+        {
+            decompressor.decodeToken();
+        }
+    }
+
+    Lz0103Decompressor<LzStreamDecompressor<true>> decompressor;
+};
+
+Lz0103StreamDecompressor::Lz0103StreamDecompressor(
+    const bool rle, std::function<void(const uint8_t* data, size_t size)> callback)
+    : m_impl{std::make_unique<Impl>(rle, std::move(callback))}
+{
+}
+
+Lz0103StreamDecompressor::~Lz0103StreamDecompressor() = default;
+
+void Lz0103StreamDecompressor::feed(const uint8_t* data, const size_t size)
+{
+    m_impl->decompressor.lzss().feed(data, size);
+    m_impl->decode();
+}
+
+void Lz0103StreamDecompressor::finish()
+{
+    m_impl->decompressor.lzss().setFinishing();
+    m_impl->decode();
+    m_impl->decompressor.lzss().finish();
+}
+
+Lz01StreamDecompressor::Lz01StreamDecompressor(
+    std::function<void(const uint8_t* data, size_t size)> callback)
+    : Lz0103StreamDecompressor{false, std::move(callback)}
+{
+}
+
+Lz03StreamDecompressor::Lz03StreamDecompressor(
+    std::function<void(const uint8_t* data, size_t size)> callback)
+    : Lz0103StreamDecompressor{true, std::move(callback)}
+{
+}
+
+// Collects a control byte and the up to eight tokens it flags, and writes them to the sink at once.
+template <class Sink> class Lz0103Compressor
 {
 public:
-    explicit Lz0103Compressor(const uint8_t* data, const size_t size, size_t zeroOffset)
-        : m_data{data}
-        , m_end{data + size}
+    explicit Lz0103Compressor(Sink& sink, size_t zeroOffset)
+        : m_sink{sink}
         , m_zeroOffset{zeroOffset}
         , m_ringBufferOffset{0}
     {
-        m_compressed.push_back(0x00);
-        m_lastFlag = 0;
     }
 
     void consumeMatch(const uint8_t* begin, const uint8_t* end,
                       const Match& match)
     {
-        m_compressed[m_lastFlag] >>= 1;
+        m_group[0] >>= 1;
 
         encodeMatch(match);
         advance(match.length);
@@ -161,35 +326,35 @@ public:
 
         const uint8_t b = (match.length - 3) | ((blub >> 8) << 4);
         const uint8_t a = blub & 0xff;
-        m_compressed.push_back(a);
-        m_compressed.push_back(b);
+        m_group[m_groupSize++] = a;
+        m_group[m_groupSize++] = b;
     }
 
     void consumeLiteral(const uint8_t* pos)
     {
-        m_compressed[m_lastFlag] >>= 1;
-        m_compressed[m_lastFlag] |= 0x80;
-        m_compressed.push_back(*pos);
+        m_group[0] >>= 1;
+        m_group[0] |= 0x80;
+        m_group[m_groupSize++] = *pos;
         advance(1);
     }
 
     void consumeMatch(const uint8_t* begin, const uint8_t* end, 
                       const RleMatch& match)
     {
-        m_compressed[m_lastFlag] >>= 1;
+        m_group[0] >>= 1;
 
         if (match.cls == 0)
         {
             auto const b = 0xF | ((match.length - 3) << 4);
-            m_compressed.push_back(*begin);
-            m_compressed.push_back(b);
+            m_group[m_groupSize++] = *begin;
+            m_group[m_groupSize++] = static_cast<uint8_t>(b);
         }
         else
         {
             auto const b = 0x0F;
-            m_compressed.push_back(match.length - 19);
-            m_compressed.push_back(b);
-            m_compressed.push_back(*begin);
+            m_group[m_groupSize++] = static_cast<uint8_t>(match.length - 19);
+            m_group[m_groupSize++] = b;
+            m_group[m_groupSize++] = *begin;
         }
 
         advance(match.length);
@@ -205,82 +370,350 @@ public:
 
         if (--m_flagsLeft == 0)
         {
+            m_sink.write(m_group.data(), m_groupSize);
             m_flagsLeft = 8;
-            m_lastFlag = m_compressed.size();
-            m_compressed.push_back(0x00);
+            m_group[0] = 0x00;
+            m_groupSize = 1;
         }
     }
 
-    auto finish() -> std::vector<uint8_t>
+    void finish()
     {
-        if (m_flagsLeft == 8)
-        {
-            m_compressed.pop_back();
-        }
-        else
+        if (m_flagsLeft != 8)
         {
-            m_compressed[m_lastFlag] >>= m_flagsLeft;
+            m_group[0] >>= m_flagsLeft;
+            m_sink.write(m_group.data(), m_groupSize);
         }
-        return std::move(m_compressed);
+        m_sink.finish();
     }
 
 private:
-    std::vector<uint8_t> m_compressed;
-    const uint8_t* m_data{nullptr};
-    const uint8_t* m_end{nullptr};
-    size_t m_lastFlag{0};
+    Sink& m_sink;
+    // control byte and tokens of up to three bytes
+    std::array<uint8_t, 1 + 8 * 3> m_group{};
+    size_t m_groupSize{1};
     uint8_t m_flagsLeft{8};
     size_t m_zeroOffset;
     size_t m_ringBufferOffset;
 };
 
-class Lz01Compressor : public Lz0103Compressor
+template <class Sink> class Lz01Compressor : public Lz0103Compressor<Sink>
 {
 public:
-    explicit Lz01Compressor(uint8_t* data, size_t size)
-        : Lz0103Compressor{data, size, 0x12}
+    explicit Lz01Compressor(Sink& sink)
+        : Lz0103Compressor<Sink>{sink, 0x12}
     {
     }
 };
 
-class Lz03Compressor : public Lz0103Compressor
+template <class Sink> class Lz03Compressor : public Lz0103Compressor<Sink>
 {
 public:
-    explicit Lz03Compressor(uint8_t* data, size_t size)
-        : Lz0103Compressor{data, size, 0x11}
+    explicit Lz03Compressor(Sink& sink)
+        : Lz0103Compressor<Sink>{sink, 0x11}
+    {
+    }
+};
+
+struct Lz0103Settings
+{
+    SearchEffort effort;
+    ParseOptions options;
+    unsigned int threads{1};
+};
+
+auto lz0103Settings(const CompressionLevel level, const unsigned int threads) -> Lz0103Settings
+{
+    // a literal takes one byte and one control bit
+    switch (level)
+    {
+    case CompressionLevel::Fast:
+        return {SearchEffort{.maxTries = 16, .goodLength = 18}, ParseOptions{.threads = threads},
+                threads};
+    case CompressionLevel::Normal:
+        return {SearchEffort{}, ParseOptions{.threads = threads}, threads};
+    case CompressionLevel::Maximum:
+        return {SearchEffort{.maxTries = 1 << 16},
+                ParseOptions{
+                    .strategy = ParseStrategy::Optimal, .literalCost = 9, .threads = threads},
+                threads};
+    default: throw std::runtime_error{"Lz0103Compressor: unsupported compression level"};
+    }
+}
+
+// The 4 KiB window fits 16 bit node indices, which halve the tree and its roots.
+auto binaryTreeMatcher() -> squeeze::BinaryTreeMatcher<1, 3, uint16_t>
+{
+    squeeze::BinaryTreeMatcher<1, 3, uint16_t> matcher{4096};
+    matcher.setFusedInsertion(true);
+    return matcher;
+}
+
+template <bool Rle, class DictMatcher>
+auto lz0103Compressor(DictMatcher&& dictMatcher, const Lz0103Settings& settings)
+{
+    if constexpr (Rle)
+    {
+        using RleMatcher = squeeze::RleMatcher<2>;
+        squeeze::LzCompressor<DictMatcher, RleMatcher> lz{
+            settings.options, std::forward<DictMatcher>(dictMatcher), RleMatcher{}};
+        lz.template matcher<DictMatcher>().setSearchEffort(settings.effort);
+        lz.template matcher<DictMatcher>().configureMatchClass(
+            0, MatchClass{0, {3, 17}, {1, 4095}, 17});
+        lz.template matcher<RleMatcher>().configureMatchClass(0, RleMatchClass{0, {4, 18}, 17});
+        lz.template matcher<RleMatcher>().configureMatchClass(
+            1, RleMatchClass{1, {19, 255 + 19}, 25});
+        return lz;
+    }
+    else
+    {
+        squeeze::LzCompressor<DictMatcher> lz{settings.options,
+                                              std::forward<DictMatcher>(dictMatcher)};
+        lz.template matcher<DictMatcher>().setSearchEffort(settings.effort);
+        lz.template matcher<DictMatcher>().configureMatchClass(
+            0, MatchClass{0, {3, 18}, {1, 4096}, 17});
+        return lz;
+    }
+}
+
+template <bool Rle, CompressionLevel Level> auto lz0103Compressor(const Lz0103Settings& settings)
+{
+    if constexpr (Level == CompressionLevel::Fast)
+    {
+        return lz0103Compressor<Rle>(squeeze::HashChainMatcher<1>{4096}, settings);
+    }
+    else
+    {
+        return lz0103Compressor<Rle>(binaryTreeMatcher(), settings);
+    }
+}
+
+template <bool Rle> auto lz0103Prefill() -> const uint8_t*
+{
+    return RingbufferPrefill + (Rle ? 1 : 0);
+}
+
+// The compressor of a format and level on one thread, primed over the ring buffer prefill once.
+// Every compression starts from a copy of it instead of priming a new one.
+template <bool Rle, CompressionLevel Level> auto primedLz0103Compressor() -> const auto&
+{
+    static const auto primed = [] {
+        auto lz = lz0103Compressor<Rle, Level>(lz0103Settings(Level, 1));
+        lz.primePrefix(lz0103Prefill<Rle>(), 4096);
+        return lz;
+    }();
+    return primed;
+}
+
+template <bool Rle, CompressionLevel Level, class Processor>
+void compressLz0103With(const uint8_t* data, const size_t size, Processor& lz0103,
+                        const unsigned int threads)
+{
+    if (threads == 1)
+    {
+        auto lz = primedLz0103Compressor<Rle, Level>();
+        lz.compressWithPrefix(lz0103Prefill<Rle>(), 4096, data, size, lz0103);
+    }
+    else
+    {
+        // parallel compression needs the prefill in front of the data in one buffer
+        std::vector<uint8_t> prefixedData(size + 4096);
+        std::memcpy(prefixedData.data(), lz0103Prefill<Rle>(), 4096);
+        std::memcpy(prefixedData.data() + 4096, data, size);
+        auto lz = lz0103Compressor<Rle, Level>(lz0103Settings(Level, threads));
+        lz.compressParallel(prefixedData.data(), prefixedData.size(), lz0103, 4096);
+    }
+}
+
+template <bool Rle, class Processor>
+void compressLz0103(const uint8_t* data, const size_t size, Processor& lz0103,
+                    const CompressionLevel level, const unsigned int threads)
+{
+    switch (level)
+    {
+    case CompressionLevel::Fast:
+        compressLz0103With<Rle, CompressionLevel::Fast>(data, size, lz0103, threads);
+        break;
+    case CompressionLevel::Normal:
+        compressLz0103With<Rle, CompressionLevel::Normal>(data, size, lz0103, threads);
+        break;
+    case CompressionLevel::Maximum:
+        compressLz0103With<Rle, CompressionLevel::Maximum>(data, size, lz0103, threads);
+        break;
+    default: throw std::runtime_error{"Lz0103Compressor: unsupported compression level"};
+    }
+}
+
+template <class Sink>
+void compressLz03Into(const uint8_t* data, const size_t size, Sink& sink,
+                      const CompressionLevel level, const unsigned int threads)
+{
+    Lz03Compressor<Sink> lz0103{sink};
+    compressLz0103<true>(data, size, lz0103, level, threads);
+    lz0103.finish();
+}
+
+template <class Sink>
+void compressLz01Into(const uint8_t* data, const size_t size, Sink& sink,
+                      const CompressionLevel level, const unsigned int threads)
+{
+    Lz01Compressor<Sink> lz0103{sink};
+    compressLz0103<false>(data, size, lz0103, level, threads);
+    lz0103.finish();
+}
+
+struct Lz0103Context::Impl
+{
+    explicit Impl(const bool rle)
+        : decompressor{rle}
     {
+        if (rle)
+        {
+            compressors.emplace<Compressors<true>>();
+        }
     }
+
+    // Working copies of the primed compressors of a format, restored for every compression.
+    // Normal and Maximum share one.
+    template <bool Rle> struct Compressors
+    {
+        template <CompressionLevel Level>
+        using Lz = std::decay_t<decltype(primedLz0103Compressor<Rle, Level>())>;
+
+        template <CompressionLevel Level> auto working() -> std::optional<Lz<Level>>&
+        {
+            if constexpr (Level == CompressionLevel::Fast)
+            {
+                return fast;
+            }
+            else
+            {
+                return tree;
+            }
+        }
+
+        std::optional<Lz<CompressionLevel::Fast>> fast;
+        std::optional<Lz<CompressionLevel::Normal>> tree;
+    };
+
+    template <bool Rle, CompressionLevel Level, class Processor>
+    void compress(Compressors<Rle>& compressors, const uint8_t* data, const size_t size,
+                  Processor& lz0103)
+    {
+        auto& lz = restoreCompressor(compressors.template working<Level>(),
+                                     primedLz0103Compressor<Rle, Level>());
+        lz.compressWithPrefix(lz0103Prefill<Rle>(), 4096, data, size, lz0103);
+    }
+
+    template <bool Rle, class Processor>
+    void compress(Compressors<Rle>& compressors, const uint8_t* data, const size_t size,
+                  Processor& lz0103, const CompressionLevel level)
+    {
+        switch (level)
+        {
+        case CompressionLevel::Fast:
+            compress<Rle, CompressionLevel::Fast>(compressors, data, size, lz0103);
+            break;
+        case CompressionLevel::Normal:
+            compress<Rle, CompressionLevel::Normal>(compressors, data, size, lz0103);
+            break;
+        case CompressionLevel::Maximum:
+            compress<Rle, CompressionLevel::Maximum>(compressors, data, size, lz0103);
+            break;
+        default: throw std::runtime_error{"Lz0103Compressor: unsupported compression level"};
+        }
+    }
+
+    // those of the format of the context only
+    std::variant<Compressors<false>, Compressors<true>> compressors;
+    VectorSink sink;
+    Lz0103Decompressor<LzDecompressor<true, ReusableVectorOutput>> decompressor;
 };
 
-auto compressLz03(const uint8_t* data, const size_t size) -> std::vector<uint8_t>
+Lz0103Context::Lz0103Context(const bool rle)
+    : m_impl{std::make_unique<Impl>(rle)}
 {
-    std::vector<uint8_t> prefixedData(size + 4096);
-    std::memcpy(prefixedData.data(), RingbufferPrefill + 1, 4096);
-    std::memcpy(prefixedData.data() + 4096, data, size);
+}
+
+Lz0103Context::~Lz0103Context() = default;
 
-    using DictMatcher = squeeze::BinaryTreeMatcher<1>;
-    using RleMatcher = squeeze::RleMatcher<2>;
-    Lz03Compressor lz0103(prefixedData.data(), prefixedData.size());
-    squeeze::LzCompressor<DictMatcher, RleMatcher> lz{DictMatcher(4096), RleMatcher{}};
-    lz.matcher<DictMatcher>().configureMatchClass(0, MatchClass{0, {3, 17}, {1, 4095}});
-    lz.matcher<RleMatcher>().configureMatchClass(0, RleMatchClass{0, {4, 18}});
-    lz.matcher<RleMatcher>().configureMatchClass(1, RleMatchClass{1, {19, 255+19}});
-    lz.compress(prefixedData.data(), prefixedData.size(), lz0103, 4096);
-    return lz0103.finish();
+auto Lz0103Context::compress(const uint8_t* data, const size_t size, const CompressionLevel level)
+    -> const std::vector<uint8_t>&
+{
+    m_impl->sink.clear();
+    std::visit(
+        [&]<bool Rle>(Impl::Compressors<Rle>& compressors) {
+            std::conditional_t<Rle, Lz03Compressor<VectorSink>, Lz01Compressor<VectorSink>> lz0103{
+                m_impl->sink};
+            m_impl->compress(compressors, data, size, lz0103, level);
+            lz0103.finish();
+        },
+        m_impl->compressors);
+    return m_impl->sink.data();
+}
+
+auto Lz0103Context::decompress(const uint8_t* data, const size_t size)
+    -> std::span<const uint8_t>
+{
+    return m_impl->decompressor.decompress(data, size);
+}
+
+Lz01Context::Lz01Context()
+    : Lz0103Context{false}
+{
+}
+
+Lz03Context::Lz03Context()
+    : Lz0103Context{true}
+{
+}
+
+auto compressLz01(const uint8_t* data, const size_t size, const CompressionLevel level,
+                  const unsigned int threads) -> std::vector<uint8_t>
+{
+    VectorSink sink;
+    compressLz01Into(data, size, sink, level, threads);
+    return sink.take();
+}
+
+auto compressLz01(const uint8_t* data, const size_t size, uint8_t* output, const size_t capacity,
+                  const CompressionLevel level, const unsigned int threads) -> size_t
+{
+    BufferSink sink{output, capacity};
+    compressLz01Into(data, size, sink, level, threads);
+    return sink.size();
+}
+
+void compressLz01(const uint8_t* data, const size_t size,
+                  std::function<void(const uint8_t* data, size_t size)> callback,
+                  const CompressionLevel level, const unsigned int threads)
+{
+    CallbackSink sink{std::move(callback)};
+    compressLz01Into(data, size, sink, level, threads);
+}
+
+auto compressLz03(const uint8_t* data, const size_t size, const CompressionLevel level,
+                  const unsigned int threads) -> std::vector<uint8_t>
+{
+    VectorSink sink;
+    compressLz03Into(data, size, sink, level, threads);
+    return sink.take();
 }
 
-auto compressLz01(const uint8_t* data, const size_t size) -> std::vector<uint8_t>
+auto compressLz03(const uint8_t* data, const size_t size, uint8_t* output, const size_t capacity,
+                  const CompressionLevel level, const unsigned int threads) -> size_t
 {
-    std::vector<uint8_t> prefixedData(size + 4096);
-    std::memcpy(prefixedData.data(), RingbufferPrefill, 4096);
-    std::memcpy(prefixedData.data() + 4096, data, size);
+    BufferSink sink{output, capacity};
+    compressLz03Into(data, size, sink, level, threads);
+    return sink.size();
+}
 
-    using DictMatcher = squeeze::BinaryTreeMatcher<1>;
-    Lz01Compressor lz0103(prefixedData.data(), prefixedData.size());
-    squeeze::LzCompressor<DictMatcher> lz{DictMatcher{4096}};
-    lz.matcher<DictMatcher>().configureMatchClass(0, MatchClass{0, {3, 18}, {1, 4096}});
-    lz.compress(prefixedData.data(), prefixedData.size(), lz0103, 4096);
-    return lz0103.finish();
+void compressLz03(const uint8_t* data, const size_t size,
+                  std::function<void(const uint8_t* data, size_t size)> callback,
+                  const CompressionLevel level, const unsigned int threads)
+{
+    CallbackSink sink{std::move(callback)};
+    compressLz03Into(data, size, sink, level, threads);
 }
 
-} // namespace squeeze
\ No newline at end of file
+} // namespace squeeze
@@ -1,14 +1,133 @@
 #pragma once
 
+#include "Common.h"
 #include <cstddef>
 #include <cstdint>
+#include <functional>
+#include <memory>
+#include <span>
 #include <vector>
 
 namespace squeeze {
 
-auto compressLz01(const uint8_t* data, const size_t size) -> std::vector<uint8_t>;
-auto decompressLz01(const uint8_t* data, const size_t size) -> std::vector<uint8_t>;
-auto compressLz03(const uint8_t* data, const size_t size) -> std::vector<uint8_t>;
-auto decompressLz03(const uint8_t* data, const size_t size) -> std::vector<uint8_t>;
+// With threads other than 1, blocks of the input are compressed in parallel (0: on all cores).
+auto compressLz01(const uint8_t* data, const size_t size,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1) -> std::vector<uint8_t>;
+// Like above, but writes the output into a buffer of capacity bytes and returns its size. Throws if
+// it does not fit.
+auto compressLz01(const uint8_t* data, const size_t size, uint8_t* output, const size_t capacity,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1) -> size_t;
+// Like above, but passes the output to the callback in chunks, e.g. to write it to a file.
+void compressLz01(const uint8_t* data, const size_t size,
+                  std::function<void(const uint8_t* data, size_t size)> callback,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1);
+// expectedSize, if known, lets the output be allocated once.
+auto decompressLz01(const uint8_t* data, const size_t size, const size_t expectedSize = 0)
+    -> std::vector<uint8_t>;
+// Like above, but replaces output with the data in a ByteVector, which grows without zeroing.
+void decompressLz01(const uint8_t* data, const size_t size, ByteVector& output,
+                    const size_t expectedSize = 0);
+// Like above, but writes the output into a buffer of capacity bytes and returns its size. Throws if
+// it does not fit. Bytes of the buffer after the output may be overwritten.
+auto decompressLz01(const uint8_t* data, const size_t size, uint8_t* output,
+                    const size_t capacity) -> size_t;
+// Returns the size of the decompressed data, e.g. as expectedSize, without decompressing it.
+// Throws if the compressed data is truncated or refers to data before its start.
+auto decompressedSizeLz01(const uint8_t* data, const size_t size) -> size_t;
+auto compressLz03(const uint8_t* data, const size_t size,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1) -> std::vector<uint8_t>;
+// Like above, but writes the output into a buffer of capacity bytes and returns its size. Throws if
+// it does not fit.
+auto compressLz03(const uint8_t* data, const size_t size, uint8_t* output, const size_t capacity,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1) -> size_t;
+// Like above, but passes the output to the callback in chunks, e.g. to write it to a file.
+void compressLz03(const uint8_t* data, const size_t size,
+                  std::function<void(const uint8_t* data, size_t size)> callback,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1);
+// expectedSize, if known, lets the output be allocated once.
+auto decompressLz03(const uint8_t* data, const size_t size, const size_t expectedSize = 0)
+    -> std::vector<uint8_t>;
+// Like above, but replaces output with the data in a ByteVector, which grows without zeroing.
+void decompressLz03(const uint8_t* data, const size_t size, ByteVector& output,
+                    const size_t expectedSize = 0);
+// Like above, but writes the output into a buffer of capacity bytes and returns its size. Throws if
+// it does not fit. Bytes of the buffer after the output may be overwritten.
+auto decompressLz03(const uint8_t* data, const size_t size, uint8_t* output,
+                    const size_t capacity) -> size_t;
+// Returns the size of the decompressed data, e.g. as expectedSize, without decompressing it.
+// Throws if the compressed data is truncated or refers to data before its start.
+auto decompressedSizeLz03(const uint8_t* data, const size_t size) -> size_t;
+
+// Keeps the compressors and output buffers of a call for the next one, so that compressing or
+// decompressing many small files allocates nothing once the buffers fit the largest of them. The
+// returned data is valid until the next call. Compresses on the calling thread; not thread-safe,
+// use one context per thread.
+class Lz0103Context
+{
+public:
+    ~Lz0103Context();
+
+    auto compress(const uint8_t* data, const size_t size,
+                  const CompressionLevel level = CompressionLevel::Normal)
+        -> const std::vector<uint8_t>&;
+    auto decompress(const uint8_t* data, const size_t size) -> std::span<const uint8_t>;
+
+protected:
+    explicit Lz0103Context(const bool rle);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+class Lz01Context : public Lz0103Context
+{
+public:
+    Lz01Context();
+};
+
+class Lz03Context : public Lz0103Context
+{
+public:
+    Lz03Context();
+};
+
+// Decompresses data fed in chunks of any size, keeping only the 4 KiB ring buffer in memory. The
+// decompressed data is passed to the callback in chunks.
+class Lz0103StreamDecompressor
+{
+public:
+    ~Lz0103StreamDecompressor();
+
+    void feed(const uint8_t* data, const size_t size);
+    // Decodes the rest of the input. Throws if the compressed data ends within a token.
+    void finish();
+
+protected:
+    Lz0103StreamDecompressor(const bool rle,
+                             std::function<void(const uint8_t* data, size_t size)> callback);
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+class Lz01StreamDecompressor : public Lz0103StreamDecompressor
+{
+public:
+    explicit Lz01StreamDecompressor(std::function<void(const uint8_t* data, size_t size)> callback);
+};
+
+class Lz03StreamDecompressor : public Lz0103StreamDecompressor
+{
+public:
+    explicit Lz03StreamDecompressor(std::function<void(const uint8_t* data, size_t size)> callback);
+};
 
 } // namespace squeeze
\ No newline at end of file
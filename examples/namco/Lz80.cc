@@ -1,153 +1,273 @@
 #include "Lz80.h"
+#include <array>
 #include <iostream>
 #include <squeeze.h>
 #include <stdexcept>
 
 namespace squeeze {
 
-class Lz80Decompressor
+// How a flags byte decodes. Matches take their length and offset from the table and the two bytes
+// after the flags byte, read as one big endian value: length + ((next >> 15) & lengthMask) and
+// offset + ((next >> offsetShift) & offsetMask).
+struct Lz80Token
+{
+    enum Kind : uint8_t
+    {
+        Literals,
+        // flags byte 0: one or two more bytes give the number of literals, or mark the end
+        LongLiterals,
+        Match,
+    };
+
+    Kind kind{Literals};
+    // bytes of the token, except for LongLiterals
+    uint8_t size{1};
+    uint8_t length{0};
+    uint8_t lengthMask{0};
+    uint8_t offsetShift{0};
+    uint16_t offset{0};
+    uint16_t offsetMask{0};
+};
+
+constexpr auto makeLz80TokenTable() -> std::array<Lz80Token, 256>
+{
+    std::array<Lz80Token, 256> table{};
+    for (unsigned int flags = 0; flags < 256; ++flags)
+    {
+        auto& token = table[flags];
+        switch (flags >> 6)
+        {
+        case 0:
+            // 0 < length < 0x40
+            token.kind = flags == 0 ? Lz80Token::LongLiterals : Lz80Token::Literals;
+            token.length = static_cast<uint8_t>(flags & 0x3f);
+            break;
+        case 1:
+            // 2 <= length < 6, 1 <= offset < 17, both from the flags byte
+            token.kind = Lz80Token::Match;
+            token.length = static_cast<uint8_t>(2 + ((flags >> 4) & 0x3));
+            token.offset = static_cast<uint16_t>(1 + (flags & 0xf));
+            break;
+        case 2:
+            // 3 <= length < 19 from the flags byte, 1 <= offset < 1025 with the next byte
+            token.kind = Lz80Token::Match;
+            token.size = 2;
+            token.length = static_cast<uint8_t>(3 + ((flags >> 2) & 0xf));
+            token.offset = static_cast<uint16_t>(1 + ((flags & 0x3) << 8));
+            token.offsetShift = 8;
+            token.offsetMask = 0xff;
+            break;
+        default:
+            // 4 <= length < 132 with the next byte, 1 <= offset < 32769 from the next two bytes
+            token.kind = Lz80Token::Match;
+            token.size = 3;
+            token.length = static_cast<uint8_t>(4 + ((flags & 0x3f) << 1));
+            token.lengthMask = 1;
+            token.offset = 1;
+            token.offsetMask = 0x7fff;
+            break;
+        }
+    }
+    return table;
+}
+
+constexpr auto Lz80TokenTable = makeLz80TokenTable();
+
+template <class Lzss> class Lz80Decompressor
 {
 public:
-    auto decompress(const uint8_t* data, const size_t size) -> std::vector<uint8_t>;
+    // longest token without its literals: flags byte and two length bytes, read as one word of
+    // four bytes
+    static constexpr size_t MaxTokenLength = 4;
+
+    template <class... Args>
+    explicit Lz80Decompressor(Args&&... lzssArgs)
+        : m_lzss(std::forward<Args>(lzssArgs)...)
+    {
+    }
 
-    bool copyUncompressed(const uint8_t flags);
-    void copyFromRingBuffer1(const uint8_t flags);
-    void copyFromRingBuffer2(const uint8_t flags);
-    void copyFromRingBuffer3(const uint8_t flags);
+    // Returns what Lzss::finish() returns.
+    decltype(auto) decompress(const uint8_t* data, const size_t size,
+                              const size_t expectedSize = 0);
+
+    // Decodes the next token. Returns true at the end of the compressed stream.
+    bool decodeToken();
+
+    bool copyLongLiterals(const unsigned int next);
 
     void emitLiterals(const size_t length);
     void emitMatch(const size_t offset, const size_t length);
 
+    auto lzss() -> Lzss&
+    {
+        return m_lzss;
+    }
+
 private:
-    squeeze::LzDecompressor<true> m_lzss;
+    Lzss m_lzss;
 };
 
-auto Lz80Decompressor::decompress(const uint8_t* data, const size_t size) -> std::vector<uint8_t>
+template <class Lzss>
+decltype(auto) Lz80Decompressor<Lzss>::decompress(const uint8_t* data, const size_t size,
+                                        const size_t expectedSize)
 {
-    m_lzss.reset(data, size);
+    m_lzss.reset(data, size, nullptr, 0, expectedSize);
 
-    while (!m_lzss.isAtEnd())
+    while (m_lzss.canDecode(MaxTokenLength))
     {
-        auto const flags = m_lzss.fetch();
-        switch (flags >> 6)
+        if (decodeToken())
         {
-        case 0:
-            if (copyUncompressed(flags))
-            {
-                return m_lzss.finish();
-            }
             break;
-        case 1: copyFromRingBuffer1(flags); break;
-        case 2: copyFromRingBuffer2(flags); break;
-        case 3: copyFromRingBuffer3(flags); break;
-        default: throw std::runtime_error{"Lz80Decompressor: encountered invalid flags byte"};
         }
     }
     return m_lzss.finish();
 }
 
-bool Lz80Decompressor::copyUncompressed(const uint8_t flags)
+template <class Lzss> bool Lz80Decompressor<Lzss>::decodeToken()
+{
+    auto const word = m_lzss.peek();
+    auto const& token = Lz80TokenTable[word & 0xff];
+    auto const next = ((word >> 8) & 0xff) << 8 | ((word >> 16) & 0xff);
+    if (token.kind == Lz80Token::Match)
+    {
+        m_lzss.skip(token.size);
+        emitMatch(token.offset + ((next >> token.offsetShift) & token.offsetMask),
+                  token.length + ((next >> 15) & token.lengthMask));
+        return false;
+    }
+    if (token.kind == Lz80Token::Literals)
+    {
+        m_lzss.skip(1);
+        emitLiterals(token.length);
+        return false;
+    }
+    return copyLongLiterals(next);
+}
+
+template <class Lzss> bool Lz80Decompressor<Lzss>::copyLongLiterals(const unsigned int next)
 {
-    size_t length = flags & 0x3f;
     //    0  < length < 0x40   : only flags byte
     // 0x40 <= length < 0xC0   : flags byte + one byte
     // 0xC0 <= length < 0x81C0 : flags byte + two bytes
-    if (length == 0)
+    auto const firstByte = next >> 8;
+    if (firstByte >> 7 != 0)
     {
-        auto const firstByte = m_lzss.fetch();
-        if (firstByte >> 7 == 0)
-        {
-            auto const secondByte = m_lzss.fetch();
-            if (firstByte == 0 && secondByte == 0)
-            {
-                // indicator for completion
-                return true;
-            }
-            length = 0xbf + ((firstByte << 8) | secondByte);
-        }
-        else
-        {
-            length = 0x40 + (firstByte & 0x7f);
-        }
+        m_lzss.skip(2);
+        emitLiterals(0x40 + (firstByte & 0x7f));
+        return false;
+    }
+    m_lzss.skip(3);
+    if (next == 0)
+    {
+        // indicator for completion
+        return true;
     }
+    emitLiterals(0xbf + next);
+    return false;
+}
 
-    emitLiterals(length);
+template <class Lzss> void Lz80Decompressor<Lzss>::emitLiterals(const size_t length)
+{
+    // std::cout << m_lzss.position() << " / " << m_lzss.decompressedPosition()
+    //<< " Literals: " << length << "\n";
+    m_lzss.emitLiterals(length);
+}
 
-    // continue decompressing
-    return false;
+template <class Lzss>
+void Lz80Decompressor<Lzss>::emitMatch(const size_t offset, const size_t length)
+{
+    // std::cout << m_lzss.position() << " / " << m_lzss.decompressedPosition()
+    //<< " Match   : " << offset << ", " << length << "\n";
+    m_lzss.emitMatch(offset, length);
 }
 
-void Lz80Decompressor::copyFromRingBuffer1(const uint8_t flags)
+auto decompressLz80(const uint8_t* data, const size_t size, const size_t expectedSize)
+    -> std::vector<uint8_t>
 {
-    // both only from flags
-    // 2 <= length < 6
-    const size_t length = 2 + ((flags >> 4) & 0x3);
-    // 1 <= offset < 17
-    const size_t offset = 1 + (flags & 0xf);
-    emitMatch(offset, length);
+    return Lz80Decompressor<LzDecompressor<true>>{}.decompress(data, size, expectedSize);
 }
 
-void Lz80Decompressor::copyFromRingBuffer2(const uint8_t flags)
+void decompressLz80(const uint8_t* data, const size_t size, ByteVector& output,
+                    const size_t expectedSize)
 {
-    auto const lsb = m_lzss.fetch();
-    // length only from flags, offset from combination
-    // 3 <= length < 19
-    const size_t length = 3 + ((flags >> 2) & 0xf);
-    // 1 <= offset < 1025
-    const size_t offset = 1 + (((flags & 0x3) << 8) | lsb);
-    emitMatch(offset, length);
+    Lz80Decompressor<LzDecompressor<true, VectorOutput<ByteVector>>> lz;
+    output = lz.decompress(data, size, expectedSize);
 }
 
-void Lz80Decompressor::copyFromRingBuffer3(const uint8_t flags)
+auto decompressLz80(const uint8_t* data, const size_t size, uint8_t* output,
+                    const size_t capacity) -> size_t
 {
-    auto const lsb1 = m_lzss.fetch();
-    auto const lsb2 = m_lzss.fetch();
-    // from flags and next byte; 4 <= length < 132
-    const size_t length = 4 + (((flags & 0x3F) << 1) | (lsb1 >> 7));
-    // from two next bytes; 1 <= offset < 32769
-    const size_t offset = 1 + (((lsb1 & 0x7F) << 8) | lsb2);
-    emitMatch(offset, length);
+    Lz80Decompressor<LzDecompressor<true, BufferOutput>> lz{output, capacity};
+    return lz.decompress(data, size);
 }
 
-void Lz80Decompressor::emitLiterals(const size_t length)
+auto decompressedSizeLz80(const uint8_t* data, const size_t size) -> size_t
 {
-    // std::cout << m_lzss.position() << " / " << m_lzss.decompressedPosition()
-    //<< " Literals: " << length << "\n";
-    m_lzss.emitLiterals(length);
+    return Lz80Decompressor<LzSizeScanner>{}.decompress(data, size);
 }
 
-void Lz80Decompressor::emitMatch(const size_t offset, const size_t length)
+struct Lz80StreamDecompressor::Impl
+{
+    explicit Impl(std::function<void(const uint8_t* data, size_t size)> callback)
+        : decompressor{32768, std::move(callback)}
+    {
+    }
+
+    void decode()
+    {
+        auto& lzss = decompressor.lzss();
+        while (!ended && lzss.canDecode(decltype(decompressor)::MaxTokenLength))
+        {
+            ended = decompressor.decodeToken();
+        }
+    }
+
+    Lz80Decompressor<LzStreamDecompressor<true>> decompressor;
+    // data after the end of the compressed stream is ignored
+    bool ended{false};
+};
+
+Lz80StreamDecompressor::Lz80StreamDecompressor(
+    std::function<void(const uint8_t* data, size_t size)> callback)
+    : m_impl{std::make_unique<Impl>(std::move(callback))}
 {
-    // std::cout << m_lzss.position() << " / " << m_lzss.decompressedPosition()
-    //<< " Match   : " << offset << ", " << length << "\n";
-    m_lzss.emitMatch(offset, length);
 }
 
-auto decompressLz80(const uint8_t* data, const size_t size) -> std::vector<uint8_t>
+Lz80StreamDecompressor::~Lz80StreamDecompressor() = default;
+
+void Lz80StreamDecompressor::feed(const uint8_t* data, const size_t size)
 {
-    return Lz80Decompressor{}.decompress(data, size);
+    if (!m_impl->ended)
+    {
+        m_impl->decompressor.lzss().feed(data, size);
+        m_impl->decode();
+    }
 }
 
-class Lz80Compressor
+void Lz80StreamDecompressor::finish()
+{
+    m_impl->decompressor.lzss().setFinishing();
+    m_impl->decode();
+    m_impl->decompressor.lzss().finish();
+}
+
+template <class Sink> class Lz80Compressor
 {
 public:
-    explicit Lz80Compressor(const uint8_t* data, const size_t size)
-        : m_data{data}
-        , m_literalStart{data}
-        , m_literalEnd{data}
-        , m_end{data + size}
+    explicit Lz80Compressor(Sink& sink)
+        : m_sink{sink}
     {
     }
 
     void consumeMatch(const uint8_t* begin, const uint8_t* end,
                       const Match& match)
     {
-        if (m_literalStart != m_literalEnd)
+        if (m_literalCount > 0)
         {
-            encodeUncompressed(begin);
+            encodeUncompressed();
         }
 
-        // std::cout << m_compressed.size() << " / " << (begin - m_data) << " "
+        // std::cout << m_sink.size() << " / " << (begin - m_data) << " "
         //<< "Match   : " << match.offset << ", " << match.length << "\n";
 
         switch (match.cls)
@@ -157,8 +277,6 @@ public:
         case 2: encodeMatch2(match); break;
         default: break;
         }
-
-        m_literalStart = m_literalEnd = end;
     }
 
     void encodeMatch0(const Match& match)
@@ -166,7 +284,7 @@ public:
         uint8_t flags = match.offset - 1;
         flags |= (match.length - 2) << 4;
         flags |= 1 << 6;
-        m_compressed.push_back(flags);
+        m_sink.write(&flags, 1);
     }
 
     void encodeMatch1(const Match& match)
@@ -175,8 +293,8 @@ public:
         uint8_t flags = (match.length - 3) << 2;
         flags |= (adjustedOffset >> 8);
         flags |= 2 << 6;
-        m_compressed.push_back(flags);
-        m_compressed.push_back(static_cast<uint8_t>(adjustedOffset));
+        const uint8_t token[] = {flags, static_cast<uint8_t>(adjustedOffset)};
+        m_sink.write(token, sizeof(token));
     }
 
     void encodeMatch2(const Match& match)
@@ -184,101 +302,304 @@ public:
         auto const adjustedLength = match.length - 4;
         uint8_t flags = static_cast<uint8_t>(adjustedLength >> 1);
         flags |= 3 << 6;
-        m_compressed.push_back(flags);
         auto const adjustedOffset = match.offset - 1;
-        m_compressed.push_back(((adjustedOffset >> 8) & 0x7f) | ((adjustedLength & 1) << 7));
-        m_compressed.push_back(static_cast<uint8_t>(adjustedOffset));
+        const uint8_t token[] = {
+            flags,
+            static_cast<uint8_t>(((adjustedOffset >> 8) & 0x7f) | ((adjustedLength & 1) << 7)),
+            static_cast<uint8_t>(adjustedOffset)};
+        m_sink.write(token, sizeof(token));
     }
 
+    // A run of literals is kept as a pointer into the input, since the literals of a run are
+    // consecutive, unless the input moved while the run was pending.
     void consumeLiteral(const uint8_t* pos)
     {
-        m_literalEnd += 1;
+        if (m_literalCount == 0)
+        {
+            m_literalStart = pos;
+        }
+        else if (!m_literals.empty())
+        {
+            m_literals.push_back(*pos);
+        }
 
-        if (m_literalEnd - m_literalStart == 0x80bf)
+        if (++m_literalCount == 0x80bf)
         {
-            encodeUncompressed(pos + 1);
-            m_literalStart = m_literalEnd;
+            encodeUncompressed();
         }
     }
 
-    void encodeUncompressed(const uint8_t* pos)
+    // Called by LzCompressor before the input moves, e.g. when a stream slides its buffer: the
+    // pending literals are copied, and so are the rest of the run.
+    void detachInput()
     {
-        auto const length = m_literalEnd - m_literalStart;
-        // std::cout << m_compressed.size() << " / " << (pos - m_data - length) << " Literals: " <<
+        if (m_literalCount > 0 && m_literals.empty())
+        {
+            m_literals.assign(m_literalStart, m_literalStart + m_literalCount);
+        }
+    }
+
+    void encodeUncompressed()
+    {
+        auto const length = m_literalCount;
+        // std::cout << m_sink.size() << " / " << (pos - m_data - length) << " Literals: " <<
         // length
         //<< "\n";
         if (length < 0x40)
         {
-            m_compressed.push_back(static_cast<uint8_t>(length));
+            auto const header = static_cast<uint8_t>(length);
+            m_sink.write(&header, 1);
         }
         else if (length < 0xC0)
         {
             auto const adjustedLength = static_cast<uint8_t>(length - 0x40);
-            m_compressed.push_back(0x00);
-            m_compressed.push_back(0x80 | adjustedLength);
+            const uint8_t header[] = {0x00, static_cast<uint8_t>(0x80 | adjustedLength)};
+            m_sink.write(header, sizeof(header));
         }
         else
         {
             auto const adjustedLength = length - 0xbf;
-            m_compressed.push_back(0x00);
-            m_compressed.push_back(static_cast<uint8_t>(adjustedLength >> 8));
-            m_compressed.push_back(static_cast<uint8_t>(adjustedLength));
+            const uint8_t header[] = {0x00, static_cast<uint8_t>(adjustedLength >> 8),
+                                      static_cast<uint8_t>(adjustedLength)};
+            m_sink.write(header, sizeof(header));
         }
 
-        auto const oldSize = m_compressed.size();
-        m_compressed.resize(oldSize + length);
-        std::memcpy(m_compressed.data() + oldSize, m_literalStart, length);
+        m_sink.write(m_literals.empty() ? m_literalStart : m_literals.data(), length);
+        m_literals.clear();
+        m_literalCount = 0;
     }
 
-    auto finish() -> std::vector<uint8_t>
+    void finish()
     {
-        if (m_literalStart != m_literalEnd)
+        if (m_literalCount > 0)
         {
-            encodeUncompressed(m_end);
+            encodeUncompressed();
         }
 
         // end of compressed stream
-        m_compressed.push_back(0x00);
-        m_compressed.push_back(0x00);
-        m_compressed.push_back(0x00);
-
-        return std::move(m_compressed);
+        const uint8_t end[] = {0x00, 0x00, 0x00};
+        m_sink.write(end, sizeof(end));
+        m_sink.finish();
     }
 
 private:
-    std::vector<uint8_t> m_compressed;
-    const uint8_t* m_data{nullptr};
+    Sink& m_sink;
+    // literals not encoded yet
     const uint8_t* m_literalStart{nullptr};
-    const uint8_t* m_literalEnd{nullptr};
-    const uint8_t* m_end{nullptr};
+    size_t m_literalCount{0};
+    // copies of them, once the input moved
+    std::vector<uint8_t> m_literals;
 };
 
-auto compressLz80(const uint8_t* data, const size_t size, const size_t windowSize)
-    -> std::vector<uint8_t>
+// Size in bits of the headers of a run of literals, which Lz80Compressor splits into runs of at
+// most 0x80bf literals.
+auto lz80LiteralRunCost(const size_t length) -> size_t
+{
+    auto const header = [](const size_t run) -> size_t {
+        return run == 0 ? 0 : run < 0x40 ? 8 : run < 0xc0 ? 16 : 24;
+    };
+    return length / 0x80bf * 24 + header(length % 0x80bf);
+}
+
+template <class Matcher>
+auto lz80Compressor(Matcher&& matcher, const size_t windowSize, const SearchEffort& effort,
+                    const ParseOptions& options)
+{
+    squeeze::LzCompressor<Matcher> lz{options, std::forward<Matcher>(matcher)};
+    lz.matcher().setSearchEffort(effort);
+    lz.matcher().configureMatchClass(0, MatchClass{0, {2, 5}, {1, 16}});
+    if constexpr (std::tuple_size_v<typename Matcher::Matches> == 2)
+    {
+        lz.matcher().configureMatchClass(1, MatchClass{1, {3, 18}, {1, windowSize}});
+    }
+    else
+    {
+        lz.matcher().configureMatchClass(1, MatchClass{1, {3, 18}, {1, 1024}});
+        lz.matcher().configureMatchClass(2, MatchClass{2, {4, 131}, {1, windowSize}});
+    }
+    return lz;
+}
+
+template <unsigned int MatchClasses>
+auto binaryTreeMatcher(const size_t windowSize) -> BinaryTreeMatcher<MatchClasses, 2>
+{
+    BinaryTreeMatcher<MatchClasses, 2> matcher{windowSize};
+    matcher.setFusedInsertion(true);
+    return matcher;
+}
+
+template <unsigned int MatchClasses, CompressionLevel Level>
+auto lz80Compressor(const size_t windowSize)
+{
+    if constexpr (Level == CompressionLevel::Fast)
+    {
+        return lz80Compressor(HashChainMatcher<MatchClasses>{windowSize}, windowSize,
+                              SearchEffort{.maxTries = 16, .goodLength = 32}, ParseOptions{});
+    }
+    else if constexpr (Level == CompressionLevel::Normal)
+    {
+        return lz80Compressor(binaryTreeMatcher<MatchClasses>(windowSize), windowSize,
+                              SearchEffort{}, ParseOptions{});
+    }
+    else
+    {
+        return lz80Compressor(binaryTreeMatcher<MatchClasses>(windowSize), windowSize,
+                              SearchEffort{.maxTries = 1 << 16},
+                              ParseOptions{.strategy = ParseStrategy::Optimal,
+                                           .literalRunCost = lz80LiteralRunCost});
+    }
+}
+
+// Calls f.template operator()<MatchClasses, Level>() with the match classes that windowSize
+// needs and level.
+template <class F>
+void withLz80Compressor(const size_t windowSize, const CompressionLevel level, F&& f)
 {
-    Lz80Compressor lz80(data, size);
     if (windowSize <= 16)
     {
         throw std::runtime_error{"compressLz80: windowSize must be > 16"};
     }
-    else if (windowSize <= 1024)
+    auto const withLevel = [&]<unsigned int MatchClasses>() {
+        switch (level)
+        {
+        case CompressionLevel::Fast:
+            f.template operator()<MatchClasses, CompressionLevel::Fast>();
+            break;
+        case CompressionLevel::Normal:
+            f.template operator()<MatchClasses, CompressionLevel::Normal>();
+            break;
+        case CompressionLevel::Maximum:
+            f.template operator()<MatchClasses, CompressionLevel::Maximum>();
+            break;
+        default: throw std::runtime_error{"compressLz80: unsupported compression level"};
+        }
+    };
+    if (windowSize <= 1024)
     {
-        squeeze::LzCompressor<squeeze::BinaryTreeMatcher<2>> lz{
-            squeeze::BinaryTreeMatcher<2>{windowSize}};
-        lz.matcher().configureMatchClass(0, MatchClass{0, {2, 5}, {1, 16}});
-        lz.matcher().configureMatchClass(1, MatchClass{1, {3, 18}, {1, windowSize}});
-        lz.compress(data, size, lz80);
+        withLevel.template operator()<2>();
     }
     else
     {
-        squeeze::LzCompressor<squeeze::BinaryTreeMatcher<3>> lz{
-            squeeze::BinaryTreeMatcher<3>{windowSize}};
-        lz.matcher().configureMatchClass(0, MatchClass{0, {2, 5}, {1, 16}});
-        lz.matcher().configureMatchClass(1, MatchClass{1, {3, 18}, {1, 1024}});
-        lz.matcher().configureMatchClass(2, MatchClass{2, {4, 131}, {1, windowSize}});
+        withLevel.template operator()<3>();
+    }
+}
+
+template <class Lz, class Processor>
+void compressLz80With(Lz& lz, const uint8_t* data, const size_t size, Processor& lz80,
+                      const unsigned int threads)
+{
+    if (threads == 1)
+    {
         lz.compress(data, size, lz80);
     }
-    return lz80.finish();
+    else
+    {
+        auto options = lz.parseOptions();
+        options.threads = threads;
+        lz.setParseOptions(options);
+        lz.compressParallel(data, size, lz80);
+    }
+}
+
+template <class Sink>
+void compressLz80Into(const uint8_t* data, const size_t size, Sink& sink, const size_t windowSize,
+                      const CompressionLevel level, const unsigned int threads)
+{
+    Lz80Compressor<Sink> lz80{sink};
+    withLz80Compressor(windowSize, level, [&]<unsigned int MatchClasses, CompressionLevel Level>() {
+        auto lz = lz80Compressor<MatchClasses, Level>(windowSize);
+        compressLz80With(lz, data, size, lz80, threads);
+    });
+    lz80.finish();
+}
+
+struct Lz80Context::Impl
+{
+    // A compressor configured for a window size and level, and the working copy restored from it
+    // for every compression. Normal and Maximum share one, reconfigured when the level changes.
+    template <class Lz> struct Compressor
+    {
+        std::optional<Lz> configured;
+        std::optional<Lz> working;
+        size_t windowSize{0};
+        CompressionLevel level{CompressionLevel::Normal};
+    };
+
+    template <unsigned int MatchClasses, CompressionLevel Level>
+    using Lz = decltype(lz80Compressor<MatchClasses, Level>(size_t{}));
+
+    template <unsigned int MatchClasses, CompressionLevel Level>
+    auto compressor(const size_t windowSize) -> Lz<MatchClasses, Level>&
+    {
+        auto& compressor = std::get<Compressor<Lz<MatchClasses, Level>>>(compressors);
+        if (!compressor.configured || compressor.windowSize != windowSize ||
+            compressor.level != Level)
+        {
+            compressor.configured.emplace(lz80Compressor<MatchClasses, Level>(windowSize));
+            compressor.windowSize = windowSize;
+            compressor.level = Level;
+        }
+        return restoreCompressor(compressor.working, *compressor.configured);
+    }
+
+    std::tuple<Compressor<Lz<2, CompressionLevel::Fast>>,
+               Compressor<Lz<2, CompressionLevel::Normal>>,
+               Compressor<Lz<3, CompressionLevel::Fast>>,
+               Compressor<Lz<3, CompressionLevel::Normal>>>
+        compressors;
+    VectorSink sink;
+    Lz80Decompressor<LzDecompressor<true, ReusableVectorOutput>> decompressor;
+};
+
+Lz80Context::Lz80Context()
+    : m_impl{std::make_unique<Impl>()}
+{
+}
+
+Lz80Context::~Lz80Context() = default;
+
+auto Lz80Context::compress(const uint8_t* data, const size_t size, const size_t windowSize,
+                           const CompressionLevel level) -> const std::vector<uint8_t>&
+{
+    m_impl->sink.clear();
+    Lz80Compressor<VectorSink> lz80{m_impl->sink};
+    withLz80Compressor(windowSize, level, [&]<unsigned int MatchClasses, CompressionLevel Level>() {
+        m_impl->compressor<MatchClasses, Level>(windowSize).compress(data, size, lz80);
+    });
+    lz80.finish();
+    return m_impl->sink.data();
+}
+
+auto Lz80Context::decompress(const uint8_t* data, const size_t size)
+    -> std::span<const uint8_t>
+{
+    return m_impl->decompressor.decompress(data, size);
+}
+
+auto compressLz80(const uint8_t* data, const size_t size, const size_t windowSize,
+                  const CompressionLevel level, const unsigned int threads) -> std::vector<uint8_t>
+{
+    VectorSink sink;
+    compressLz80Into(data, size, sink, windowSize, level, threads);
+    return sink.take();
+}
+
+auto compressLz80(const uint8_t* data, const size_t size, uint8_t* output, const size_t capacity,
+                  const size_t windowSize, const CompressionLevel level,
+                  const unsigned int threads) -> size_t
+{
+    BufferSink sink{output, capacity};
+    compressLz80Into(data, size, sink, windowSize, level, threads);
+    return sink.size();
+}
+
+void compressLz80(const uint8_t* data, const size_t size,
+                  std::function<void(const uint8_t* data, size_t size)> callback,
+                  const size_t windowSize, const CompressionLevel level,
+                  const unsigned int threads)
+{
+    CallbackSink sink{std::move(callback)};
+    compressLz80Into(data, size, sink, windowSize, level, threads);
 }
 
-} // namespace squeeze
\ No newline at end of file
+} // namespace squeeze
@@ -1,13 +1,80 @@
 #pragma once
 
+#include "Common.h"
 #include <cstdint>
 #include <cstddef>
+#include <functional>
+#include <memory>
+#include <span>
 #include <vector>
 
 namespace squeeze {
 
-auto compressLz80(const uint8_t* data, const size_t size, const size_t windowSize = 32768)
+// With threads other than 1, blocks of the input are compressed in parallel (0: on all cores).
+auto compressLz80(const uint8_t* data, const size_t size, const size_t windowSize = 32768,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1) -> std::vector<uint8_t>;
+// Like above, but writes the output into a buffer of capacity bytes and returns its size. Throws if
+// it does not fit.
+auto compressLz80(const uint8_t* data, const size_t size, uint8_t* output, const size_t capacity,
+                  const size_t windowSize = 32768,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1) -> size_t;
+// Like above, but passes the output to the callback in chunks, e.g. to write it to a file.
+void compressLz80(const uint8_t* data, const size_t size,
+                  std::function<void(const uint8_t* data, size_t size)> callback,
+                  const size_t windowSize = 32768,
+                  const CompressionLevel level = CompressionLevel::Normal,
+                  const unsigned int threads = 1);
+// expectedSize, if known, lets the output be allocated once.
+auto decompressLz80(const uint8_t* data, const size_t size, const size_t expectedSize = 0)
     -> std::vector<uint8_t>;
-auto decompressLz80(const uint8_t* data, const size_t size) -> std::vector<uint8_t>;
+// Like above, but replaces output with the data in a ByteVector, which grows without zeroing.
+void decompressLz80(const uint8_t* data, const size_t size, ByteVector& output,
+                    const size_t expectedSize = 0);
+// Like above, but writes the output into a buffer of capacity bytes and returns its size. Throws if
+// it does not fit. Bytes of the buffer after the output may be overwritten.
+auto decompressLz80(const uint8_t* data, const size_t size, uint8_t* output,
+                    const size_t capacity) -> size_t;
+// Returns the size of the decompressed data, e.g. as expectedSize, without decompressing it.
+// Throws if the compressed data is truncated or refers to data before its start.
+auto decompressedSizeLz80(const uint8_t* data, const size_t size) -> size_t;
+
+// Keeps the compressors and output buffers of a call for the next one, so that compressing or
+// decompressing many small files allocates nothing once the buffers fit the largest of them. The
+// returned data is valid until the next call. Compresses on the calling thread; not thread-safe,
+// use one context per thread.
+class Lz80Context
+{
+public:
+    Lz80Context();
+    ~Lz80Context();
+
+    auto compress(const uint8_t* data, const size_t size, const size_t windowSize = 32768,
+                  const CompressionLevel level = CompressionLevel::Normal)
+        -> const std::vector<uint8_t>&;
+    auto decompress(const uint8_t* data, const size_t size) -> std::span<const uint8_t>;
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
+
+// Decompresses LZ80 data fed in chunks of any size, keeping only the 32 KiB window in memory. The
+// decompressed data is passed to the callback in chunks.
+class Lz80StreamDecompressor
+{
+public:
+    explicit Lz80StreamDecompressor(std::function<void(const uint8_t* data, size_t size)> callback);
+    ~Lz80StreamDecompressor();
+
+    void feed(const uint8_t* data, const size_t size);
+    // Decodes the rest of the input. Throws if the compressed data ends within a token.
+    void finish();
+
+private:
+    struct Impl;
+    std::unique_ptr<Impl> m_impl;
+};
 
 } // namespace squeeze
\ No newline at end of file
@@ -16,55 +16,178 @@ static auto requestReadOnly(py::buffer& b) -> std::pair<const uint8_t*, size_t>
                           static_cast<size_t>(info.size));
 }
 
-static auto _decompress_lz80(py::buffer buffer) -> py::bytes
+static auto requestWritable(py::buffer& b) -> std::pair<uint8_t*, size_t>
+{
+    py::buffer_info info = b.request(true);
+    if (info.ndim != 1)
+    {
+        throw std::runtime_error{"requires a 1-dimensional buffer"};
+    }
+    return std::make_pair(reinterpret_cast<uint8_t*>(info.ptr), static_cast<size_t>(info.size));
+}
+
+static auto _decompress_lz80(py::buffer buffer, const size_t expectedSize) -> py::bytes
 {
     auto const [data, size] = requestReadOnly(buffer);
-    auto const decompressed = decompressLz80(data, size);
+    auto const decompressed = decompressLz80(data, size, expectedSize);
     return py::bytes{reinterpret_cast<const char*>(decompressed.data()), decompressed.size()};
 }
 
-static auto _compress_lz80(py::buffer buffer, const size_t windowSize) -> py::bytes
+static auto _decompress_lz80_into(py::buffer buffer, py::buffer output) -> size_t
+{
+    auto const [data, size] = requestReadOnly(buffer);
+    auto const [outputData, capacity] = requestWritable(output);
+    return decompressLz80(data, size, outputData, capacity);
+}
+
+static auto _decompressed_size_lz80(py::buffer buffer) -> size_t
+{
+    auto const [data, size] = requestReadOnly(buffer);
+    return decompressedSizeLz80(data, size);
+}
+
+static auto _compress_lz80(py::buffer buffer, const size_t windowSize,
+                           const CompressionLevel level, const unsigned int threads) -> py::bytes
 {
     auto const [data, size] = requestReadOnly(buffer);
-    auto const compressed = compressLz80(data, size, windowSize);
+    auto const compressed = compressLz80(data, size, windowSize, level, threads);
     return py::bytes{reinterpret_cast<const char*>(compressed.data()), compressed.size()};
 }
 
-static auto _decompress_lz03(py::buffer buffer) -> py::bytes
+static auto _decompress_lz03(py::buffer buffer, const size_t expectedSize) -> py::bytes
 {
     auto const [data, size] = requestReadOnly(buffer);
-    auto const decompressed = decompressLz03(data, size);
+    auto const decompressed = decompressLz03(data, size, expectedSize);
     return py::bytes{reinterpret_cast<const char*>(decompressed.data()), decompressed.size()};
 }
 
-static auto _compress_lz03(py::buffer buffer) -> py::bytes
+static auto _decompress_lz03_into(py::buffer buffer, py::buffer output) -> size_t
+{
+    auto const [data, size] = requestReadOnly(buffer);
+    auto const [outputData, capacity] = requestWritable(output);
+    return decompressLz03(data, size, outputData, capacity);
+}
+
+static auto _decompressed_size_lz03(py::buffer buffer) -> size_t
+{
+    auto const [data, size] = requestReadOnly(buffer);
+    return decompressedSizeLz03(data, size);
+}
+
+static auto _compress_lz03(py::buffer buffer, const CompressionLevel level,
+                           const unsigned int threads) -> py::bytes
 {
     auto const [data, size] = requestReadOnly(buffer);
-    auto const compressed = compressLz03(data, size);
+    auto const compressed = compressLz03(data, size, level, threads);
     return py::bytes{reinterpret_cast<const char*>(compressed.data()), compressed.size()};
 }
 
-static auto _decompress_lz01(py::buffer buffer) -> py::bytes
+static auto _decompress_lz01(py::buffer buffer, const size_t expectedSize) -> py::bytes
 {
     auto const [data, size] = requestReadOnly(buffer);
-    auto const decompressed = decompressLz01(data, size);
+    auto const decompressed = decompressLz01(data, size, expectedSize);
     return py::bytes{reinterpret_cast<const char*>(decompressed.data()), decompressed.size()};
 }
 
-static auto _compress_lz01(py::buffer buffer) -> py::bytes
+static auto _decompress_lz01_into(py::buffer buffer, py::buffer output) -> size_t
+{
+    auto const [data, size] = requestReadOnly(buffer);
+    auto const [outputData, capacity] = requestWritable(output);
+    return decompressLz01(data, size, outputData, capacity);
+}
+
+static auto _decompressed_size_lz01(py::buffer buffer) -> size_t
+{
+    auto const [data, size] = requestReadOnly(buffer);
+    return decompressedSizeLz01(data, size);
+}
+
+static auto _compress_lz01(py::buffer buffer, const CompressionLevel level,
+                           const unsigned int threads) -> py::bytes
 {
     auto const [data, size] = requestReadOnly(buffer);
-    auto const compressed = compressLz01(data, size);
+    auto const compressed = compressLz01(data, size, level, threads);
     return py::bytes{reinterpret_cast<const char*>(compressed.data()), compressed.size()};
 }
 
+static auto toBytes(const std::span<const uint8_t> data) -> py::bytes
+{
+    return py::bytes{reinterpret_cast<const char*>(data.data()), data.size()};
+}
+
+template <class Context> static void bindLz0103Context(py::module_& m, const char* name)
+{
+    py::class_<Context>(m, name)
+        .def(py::init<>())
+        .def(
+            "compress",
+            [](Context& context, py::buffer buffer, const CompressionLevel level) {
+                auto const [data, size] = requestReadOnly(buffer);
+                return toBytes(context.compress(data, size, level));
+            },
+            py::arg("binary"), py::arg("level") = CompressionLevel::Normal)
+        .def("decompress", [](Context& context, py::buffer buffer) {
+            auto const [data, size] = requestReadOnly(buffer);
+            return toBytes(context.decompress(data, size));
+        });
+}
+
+// The callback receives the decompressed data as bytes.
+template <class Decompressor> static void bindStreamDecompressor(py::module_& m, const char* name)
+{
+    py::class_<Decompressor>(m, name)
+        .def(py::init([](py::function callback) {
+                 return std::make_unique<Decompressor>(
+                     [callback](const uint8_t* data, const size_t size) {
+                         callback(py::bytes{reinterpret_cast<const char*>(data), size});
+                     });
+             }),
+             py::arg("callback"))
+        .def("feed",
+             [](Decompressor& decompressor, py::buffer buffer) {
+                 auto const [data, size] = requestReadOnly(buffer);
+                 decompressor.feed(data, size);
+             })
+        .def("finish", [](Decompressor& decompressor) { decompressor.finish(); });
+}
+
 PYBIND11_MODULE(_squeeze, m)
 {
     m.doc() = "Internal squeeze module";
+    py::enum_<CompressionLevel>(m, "CompressionLevel")
+        .value("FAST", CompressionLevel::Fast)
+        .value("NORMAL", CompressionLevel::Normal)
+        .value("MAXIMUM", CompressionLevel::Maximum);
     m.def("_decompress_lz80", &_decompress_lz80)
         .def("_compress_lz80", &_compress_lz80)
         .def("_decompress_lz01", &_decompress_lz01)
         .def("_compress_lz01", &_compress_lz01)
         .def("_decompress_lz03", &_decompress_lz03)
-        .def("_compress_lz03", &_compress_lz03);
+        .def("_compress_lz03", &_compress_lz03)
+        .def("_decompress_lz80_into", &_decompress_lz80_into)
+        .def("_decompress_lz01_into", &_decompress_lz01_into)
+        .def("_decompress_lz03_into", &_decompress_lz03_into)
+        .def("_decompressed_size_lz80", &_decompressed_size_lz80)
+        .def("_decompressed_size_lz01", &_decompressed_size_lz01)
+        .def("_decompressed_size_lz03", &_decompressed_size_lz03);
+    py::class_<Lz80Context>(m, "Lz80Context")
+        .def(py::init<>())
+        .def(
+            "compress",
+            [](Lz80Context& context, py::buffer buffer, const size_t windowSize,
+               const CompressionLevel level) {
+                auto const [data, size] = requestReadOnly(buffer);
+                return toBytes(context.compress(data, size, windowSize, level));
+            },
+            py::arg("binary"), py::arg("window_size") = 32768,
+            py::arg("level") = CompressionLevel::Normal)
+        .def("decompress", [](Lz80Context& context, py::buffer buffer) {
+            auto const [data, size] = requestReadOnly(buffer);
+            return toBytes(context.decompress(data, size));
+        });
+    bindLz0103Context<Lz01Context>(m, "Lz01Context");
+    bindLz0103Context<Lz03Context>(m, "Lz03Context");
+    bindStreamDecompressor<Lz80StreamDecompressor>(m, "Lz80StreamDecompressor");
+    bindStreamDecompressor<Lz01StreamDecompressor>(m, "Lz01StreamDecompressor");
+    bindStreamDecompressor<Lz03StreamDecompressor>(m, "Lz03StreamDecompressor");
 }
@@ -1,17 +1,51 @@
 from ._squeeze import (
+    CompressionLevel,
     _decompress_lz80, _compress_lz80,
     _decompress_lz01, _compress_lz01,
-    _decompress_lz03, _compress_lz03
+    _decompress_lz03, _compress_lz03,
+    _decompress_lz80_into, _decompress_lz01_into, _decompress_lz03_into,
+    _decompressed_size_lz80, _decompressed_size_lz01, _decompressed_size_lz03,
+    # reuse compressors and buffers across calls; one per thread
+    Lz80Context, Lz01Context, Lz03Context,
+    # feed(chunk) and finish(); the decompressed data is passed to the callback in chunks
+    Lz80StreamDecompressor, Lz01StreamDecompressor, Lz03StreamDecompressor
 )
 
-decompress_lz80 = _decompress_lz80
-decompress_lz01 = _decompress_lz01
-decompress_lz03 = _decompress_lz03
-compress_lz01 = _compress_lz01
-compress_lz03 = _compress_lz03
+def decompress_lz80(binary, expected_size=0):
+    return _decompress_lz80(binary, expected_size)
 
-def compress_lz80(binary, window_size=32768):
-    return _compress_lz80(binary, window_size)
+def decompress_lz01(binary, expected_size=0):
+    return _decompress_lz01(binary, expected_size)
+
+def decompress_lz03(binary, expected_size=0):
+    return _decompress_lz03(binary, expected_size)
+
+def decompress_lz80_into(binary, output):
+    return _decompress_lz80_into(binary, output)
+
+def decompress_lz01_into(binary, output):
+    return _decompress_lz01_into(binary, output)
+
+def decompress_lz03_into(binary, output):
+    return _decompress_lz03_into(binary, output)
+
+def decompressed_size_lz80(binary):
+    return _decompressed_size_lz80(binary)
+
+def decompressed_size_lz01(binary):
+    return _decompressed_size_lz01(binary)
+
+def decompressed_size_lz03(binary):
+    return _decompressed_size_lz03(binary)
+
+def compress_lz01(binary, level=CompressionLevel.NORMAL, threads=1):
+    return _compress_lz01(binary, level, threads)
+
+def compress_lz03(binary, level=CompressionLevel.NORMAL, threads=1):
+    return _compress_lz03(binary, level, threads)
+
+def compress_lz80(binary, window_size=32768, level=CompressionLevel.NORMAL, threads=1):
+    return _compress_lz80(binary, window_size, level, threads)
 
 def compress_lz80_fast(binary):
-    return _compress_lz80(binary, 1024)
+    return _compress_lz80(binary, 1024, CompressionLevel.NORMAL, 1)
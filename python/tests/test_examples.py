@@ -38,3 +38,107 @@ def test_lz03(compression_corpus):
     compressed = squeeze.namco.compress_lz03(data)
     decompressed = squeeze.namco.decompress_lz03(compressed)
     assert decompressed == data
+
+@pytest.mark.parametrize('level', ['FAST', 'NORMAL', 'MAXIMUM'])
+@pytest.mark.parametrize('codec', ['lz80', 'lz01', 'lz03'])
+def test_compression_levels(compression_corpus, codec, level):
+    data = compression_corpus['jquery'].open('rb').read()
+    compress = getattr(squeeze.namco, f'compress_{codec}')
+    decompress = getattr(squeeze.namco, f'decompress_{codec}')
+    compressed = compress(data, level=getattr(squeeze.namco.CompressionLevel, level))
+    assert decompress(compressed) == data
+
+
+@pytest.mark.parametrize('codec', ['lz80', 'lz01', 'lz03'])
+def test_parallel_compression(compression_corpus, codec):
+    data = compression_corpus['jquery'].open('rb').read()
+    compress = getattr(squeeze.namco, f'compress_{codec}')
+    decompress = getattr(squeeze.namco, f'decompress_{codec}')
+    assert decompress(compress(data, threads=4)) == data
+
+
+@pytest.mark.parametrize('codec', ['lz80', 'lz01', 'lz03'])
+def test_expected_size(compression_corpus, codec):
+    data = compression_corpus['jquery'].open('rb').read()
+    compress = getattr(squeeze.namco, f'compress_{codec}')
+    decompress = getattr(squeeze.namco, f'decompress_{codec}')
+    compressed = compress(data)
+    assert decompress(compressed, expected_size=len(data)) == data
+    # a wrong size only costs reallocations
+    assert decompress(compressed, expected_size=10) == data
+
+
+@pytest.mark.parametrize('codec', ['lz80', 'lz01', 'lz03'])
+def test_decompress_into(compression_corpus, codec):
+    data = compression_corpus['jquery'].open('rb').read()
+    compress = getattr(squeeze.namco, f'compress_{codec}')
+    decompress_into = getattr(squeeze.namco, f'decompress_{codec}_into')
+    compressed = compress(data)
+    output = bytearray(len(data))
+    assert decompress_into(compressed, output) == len(data)
+    assert output == data
+    with pytest.raises(RuntimeError):
+        decompress_into(compressed, bytearray(len(data) - 1))
+
+
+@pytest.mark.parametrize('codec', ['lz80', 'lz01', 'lz03'])
+def test_decompressed_size(compression_corpus, codec):
+    data = compression_corpus['tod2_cover'].open('rb').read()
+    compress = getattr(squeeze.namco, f'compress_{codec}')
+    decompressed_size = getattr(squeeze.namco, f'decompressed_size_{codec}')
+    compressed = compress(data)
+    assert decompressed_size(compressed) == len(data)
+
+
+@pytest.mark.parametrize('codec, binary', [
+    ('lz80', bytes([0x05, 0x61])),  # five literals, one present
+    ('lz80', bytes([0x81])),        # truncated match
+    ('lz80', bytes([0x41])),        # match before the start
+    ('lz01', bytes([0x00, 0x12])),  # match without its second byte
+    ('lz03', bytes([0x00, 0x00, 0x0f])),  # run without its value
+])
+def test_invalid_input(codec, binary):
+    decompress = getattr(squeeze.namco, f'decompress_{codec}')
+    with pytest.raises(RuntimeError):
+        decompress(binary)
+
+
+@pytest.mark.parametrize('codec', ['lz80', 'lz01', 'lz03'])
+def test_context(compression_corpus, codec):
+    data = compression_corpus['jquery'].open('rb').read()
+    compress = getattr(squeeze.namco, f'compress_{codec}')
+    context = getattr(squeeze.namco, f'{codec.capitalize()}Context')()
+    # every call starts afresh, whatever the last one compressed
+    for chunk in [data[:1000], data, data[5000:7000], b'']:
+        for level in ['FAST', 'MAXIMUM', 'NORMAL']:
+            level = getattr(squeeze.namco.CompressionLevel, level)
+            compressed = context.compress(chunk, level=level)
+            assert compressed == compress(chunk, level=level)
+            assert context.decompress(compressed) == chunk
+
+
+@pytest.mark.parametrize('chunk_size', [1, 7, 4099])
+@pytest.mark.parametrize('codec', ['lz80', 'lz01', 'lz03'])
+def test_stream_decompressor(compression_corpus, codec, chunk_size):
+    data = compression_corpus['jquery'].open('rb').read()
+    compress = getattr(squeeze.namco, f'compress_{codec}')
+    decompress = getattr(squeeze.namco, f'decompress_{codec}')
+    compressed = compress(data)
+    chunks = []
+    decompressor = getattr(squeeze.namco, f'{codec.capitalize()}StreamDecompressor')(chunks.append)
+    for pos in range(0, len(compressed), chunk_size):
+        decompressor.feed(compressed[pos:pos + chunk_size])
+    decompressor.finish()
+    assert b''.join(chunks) == decompress(compressed)
+
+
+@pytest.mark.parametrize('codec', ['lz80', 'lz01', 'lz03'])
+def test_stream_decompressor_truncated(codec):
+    compress = getattr(squeeze.namco, f'compress_{codec}')
+    # the stream ends with a match, or with the end marker for LZ80; cut off its last byte
+    compressed = compress(b'abc' * 11)[:-1]
+    decompressor = getattr(squeeze.namco, f'{codec.capitalize()}StreamDecompressor')(lambda _: None)
+    for pos in range(len(compressed)):
+        decompressor.feed(compressed[pos:pos + 1])
+    with pytest.raises(RuntimeError):
+        decompressor.finish()
@@ -1,730 +1,3345 @@
 #pragma once
 
+#include <algorithm>
 #include <array>
+#include <bit>
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <functional>
+#include <future>
+#include <limits>
+#include <memory>
 #include <stdexcept>
+#include <thread>
 #include <tuple>
+#include <type_traits>
+#include <variant>
 #include <vector>
 #include <optional>
+#include <span>
+
+#if defined(__AVX2__)
+#define SQUEEZE_HAVE_AVX2 1
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SQUEEZE_HAVE_SSE2 1
+#endif
+#if defined(SQUEEZE_HAVE_AVX2) || defined(SQUEEZE_HAVE_SSE2)
+#include <immintrin.h>
+#endif
 
 namespace squeeze {
 
-template <bool AllowOverlapping = false> class LzDecompressor
+// Returns the number of leading bytes a and b have in common, but at most maxLength. Never reads
+// beyond a + maxLength or b + maxLength; a and b may overlap.
+template <class Iterator>
+auto matchLength(Iterator a, Iterator b, const size_t maxLength) -> size_t
 {
-public:
-    void reset(const uint8_t* data, const size_t size, const uint8_t* preData = nullptr,
-               const size_t preSize = 0)
+    size_t length{0};
+    if constexpr (std::is_pointer_v<Iterator> && sizeof(std::remove_pointer_t<Iterator>) == 1)
     {
-        m_compressed = data;
-        m_size = size;
-        m_position = 0;
-        m_decompressed.clear();
-        if (preData && preSize > 0)
+        auto const* x = reinterpret_cast<const uint8_t*>(a);
+        auto const* y = reinterpret_cast<const uint8_t*>(b);
+#if defined(SQUEEZE_HAVE_AVX2)
+        for (; length + 32 <= maxLength; length += 32)
         {
-            m_decompressed.insert(m_decompressed.begin(), preData, preData + preSize);
+            auto const vx = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(x + length));
+            auto const vy = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(y + length));
+            auto const equal =
+                static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(vx, vy)));
+            if (equal != 0xffffffffu)
+            {
+                return length + std::countr_zero(~equal);
+            }
         }
-    }
-
-    void emitMatch(const size_t offset, const size_t length)
-    {
-        auto const oldSize = m_decompressed.size();
-        m_decompressed.resize(m_decompressed.size() + length);
-        if constexpr (AllowOverlapping)
+#endif
+#if defined(SQUEEZE_HAVE_SSE2)
+        for (; length + 16 <= maxLength; length += 16)
         {
-            for (size_t i = 0; i < length; ++i)
+            auto const vx = _mm_loadu_si128(reinterpret_cast<const __m128i*>(x + length));
+            auto const vy = _mm_loadu_si128(reinterpret_cast<const __m128i*>(y + length));
+            auto const equal = static_cast<uint32_t>(_mm_movemask_epi8(_mm_cmpeq_epi8(vx, vy)));
+            if (equal != 0xffffu)
             {
-                m_decompressed[oldSize + i] = m_decompressed[oldSize + i - offset];
+                return length + std::countr_zero(~equal);
             }
         }
-        else
+#endif
+        for (; length + 8 <= maxLength; length += 8)
+        {
+            uint64_t wx, wy;
+            std::memcpy(&wx, x + length, sizeof(wx));
+            std::memcpy(&wy, y + length, sizeof(wy));
+            auto const difference = wx ^ wy;
+            if (difference != 0)
+            {
+                if constexpr (std::endian::native == std::endian::little)
+                {
+                    return length + std::countr_zero(difference) / 8;
+                }
+                else
+                {
+                    return length + std::countl_zero(difference) / 8;
+                }
+            }
+        }
+        while (length < maxLength && x[length] == y[length])
         {
-            std::memcpy(m_decompressed.data() + oldSize, m_decompressed.data() + oldSize - offset,
-                        length);
+            ++length;
         }
     }
-
-    void emitLiterals(const size_t length)
+    else
     {
-        auto const oldSize = m_decompressed.size();
-        m_decompressed.resize(m_decompressed.size() + length);
-        std::memcpy(m_decompressed.data() + oldSize, m_compressed + m_position, length);
-        m_position += length;
+        while (length < maxLength && a[length] == b[length])
+        {
+            ++length;
+        }
     }
+    return length;
+}
 
-    void emitLiterals(size_t count, uint8_t value)
+// Compares the strings a and b of the given length lexicographically. Returns the sign of the
+// comparison and the length of the common prefix.
+template <class Iterator>
+auto compareStrings(Iterator a, Iterator b, const size_t length) -> std::pair<int, size_t>
+{
+    auto const common = matchLength(a, b, length);
+    if (common == length)
     {
-        auto const oldSize = m_decompressed.size();
-        m_decompressed.resize(m_decompressed.size() + count);
-        std::memset(m_decompressed.data() + oldSize, static_cast<int>(value), count);
+        return std::make_pair(0, length);
     }
+    auto const sign = static_cast<uint8_t>(a[common]) > static_cast<uint8_t>(b[common]) ? 1 : -1;
+    return std::make_pair(sign, common);
+}
 
-    auto fetch() -> uint8_t
+// Loads four bytes, the first one into the lowest bits.
+inline auto loadLittleEndian32(const uint8_t* data) -> uint32_t
+{
+    if constexpr (std::endian::native == std::endian::little)
     {
-        return m_compressed[m_position++];
+        uint32_t word;
+        std::memcpy(&word, data, sizeof(word));
+        return word;
     }
-
-    bool isAtEnd() const
+    else
     {
-        return m_position >= m_size;
+        return data[0] | data[1] << 8 | data[2] << 16 | static_cast<uint32_t>(data[3]) << 24;
     }
+}
 
-    auto finish() -> std::vector<uint8_t>
-    {
-        return std::move(m_decompressed);
-    }
+// Number of bytes copyMatch() may write beyond the end of the match.
+inline constexpr size_t MatchCopySlack = 32;
 
-    auto position() const -> size_t
+// Copies length bytes from out - offset to out with the result of a byte by byte copy, so the
+// source may overlap the copy. Copies in blocks of 16 or 32 bytes, which may write up to
+// MatchCopySlack bytes beyond out + length. Short periods are first repeated by copying the
+// pattern before out onto itself, doubling the distance every time, until a block fits in.
+inline void copyMatch(uint8_t* out, const size_t offset, const size_t length)
+{
+    auto* const end = out + length;
+    auto distance = offset;
+    if (distance == 1)
     {
-        return m_position;
+        std::memset(out, out[-1], length);
+        return;
     }
 
-    auto decompressedPosition() const -> size_t
+    while (distance < 16 && out < end)
     {
-        return m_decompressed.size();
+        std::memcpy(out, out - distance, distance);
+        out += distance;
+        distance *= 2;
     }
-
-private:
-    const uint8_t* m_compressed{nullptr};
-    size_t m_size{0};
-    size_t m_position{0};
-    std::vector<uint8_t> m_decompressed;
-};
-
-struct Match
-{
-    size_t cls;
-    size_t offset;
-    size_t length;
-
-    bool isValid() const
+    if (distance >= 32)
     {
-        return length > 0;
+        for (; out < end; out += 32)
+        {
+            std::memcpy(out, out - distance, 32);
+        }
     }
-
-    void reset()
+    else
     {
-        offset = 0;
-        length = 0;
+        for (; out < end; out += 16)
+        {
+            std::memcpy(out, out - distance, 16);
+        }
     }
-};
+}
 
-struct Range
+// std::allocator, except that elements constructed without arguments are default-initialized, so
+// that resizing a std::vector of bytes leaves the new bytes as they are instead of zeroing them.
+template <class T> class DefaultInitAllocator : public std::allocator<T>
 {
-    size_t min{0};
-    size_t max{0};
+public:
+    DefaultInitAllocator() = default;
 
-    bool contains(const size_t value) const
+    template <class U>
+    DefaultInitAllocator(const DefaultInitAllocator<U>&) noexcept
     {
-        return value >= min && value <= max;
     }
-};
-
-struct MatchClass
-{
-    using Match = squeeze::Match;
-
-    size_t overhead{0};
-    Range length;
-    Range offset;
 
-    auto quality(const Match& match) const -> int
+    template <class U, class... Args> void construct(U* p, Args&&... args)
     {
-        return match.length - overhead;
+        if constexpr (sizeof...(Args) == 0)
+        {
+            ::new (static_cast<void*>(p)) U;
+        }
+        else
+        {
+            ::new (static_cast<void*>(p)) U(std::forward<Args>(args)...);
+        }
     }
 };
 
-template <class _MatchClass, unsigned int MatchClasses> class StringMatcher
+// Decompressed data, written to after the buffer has been resized.
+using ByteVector = std::vector<uint8_t, DefaultInitAllocator<uint8_t>>;
+
+// Output of LzDecompressor: a vector that grows geometrically, always with MatchCopySlack bytes to
+// spare. A good expectedSize allocates it just once. A std::vector zeroes the bytes it grows by, a
+// ByteVector does not.
+template <class Vector = std::vector<uint8_t>> class VectorOutput
 {
 public:
-    using MatchClass = _MatchClass;
-    using Match = typename MatchClass::Match;
-
-    constexpr auto matchClassCount() const -> unsigned int
+    void prepare(const size_t expectedSize)
     {
-        return MatchClasses;
+        m_data.clear();
+        if (expectedSize > 0)
+        {
+            m_data.resize(expectedSize + MatchCopySlack);
+        }
     }
 
-    void configureMatchClass(const unsigned int index, const MatchClass& matchClass)
+    // Returns the output with room for size bytes.
+    auto reserve(const size_t size) -> uint8_t*
     {
-        m_matchClasses[index] = matchClass;
-
-        m_maxMatchLength = 0;
-        for (auto const& cls : m_matchClasses)
+        if (size + MatchCopySlack > m_data.size())
         {
-            m_maxMatchLength = std::max(m_maxMatchLength, cls.length.max);
+            reallocate(std::max(size + MatchCopySlack, 2 * m_data.size()), m_data.size());
         }
+        return m_data.data();
     }
 
-    auto matchClass(const unsigned int index) const -> const MatchClass&
+    auto capacity() const -> size_t
     {
-        return m_matchClasses[index];
+        return m_data.size();
     }
 
-    auto match(const unsigned int index) const -> const typename MatchClass::Match&
+    // The vector keeps the capacity it grew to, rather than copying the data to trim it.
+    auto finish(const size_t size) -> Vector
     {
-        return m_matches[index];
+        m_data.resize(size);
+        return std::move(m_data);
     }
 
-    auto bestMatch() const -> unsigned int
+private:
+    // A std::vector with another allocator than std::allocator moves its bytes one by one.
+    void reallocate(const size_t size, const size_t kept)
     {
-        unsigned int best_i{0};
-        int quality{0};
-        for (unsigned int i = 0; i < matchClassCount(); ++i)
+        Vector data(size);
+        if (kept > 0)
         {
-            if (match(i).isValid())
-            {
-                auto const thisQuality = matchClass(i).quality(match(i));
-                if (thisQuality > quality)
-                {
-                    best_i = i;
-                    quality = thisQuality;
-                }
-            }
+            std::memcpy(data.data(), m_data.data(), kept);
         }
-        return best_i;
+        m_data = std::move(data);
     }
 
-    auto maxMatchLength() const -> size_t
+    Vector m_data;
+};
+
+// Like VectorOutput, but keeps the vector at its largest size for the next decompression: finish()
+// returns a view of the data, valid until then. Once the vector is as large as the largest output,
+// decompressing neither allocates nor zeroes anything.
+class ReusableVectorOutput
+{
+public:
+    void prepare(const size_t expectedSize)
     {
-        return m_maxMatchLength;
+        reserve(expectedSize);
     }
 
-protected:
-    void resetMatches()
+    auto reserve(const size_t size) -> uint8_t*
     {
-        for (auto& match : m_matches)
+        if (size + MatchCopySlack > m_data.size())
         {
-            match.reset();
+            ByteVector data(std::max(size + MatchCopySlack, 2 * m_data.size()));
+            if (!m_data.empty())
+            {
+                std::memcpy(data.data(), m_data.data(), m_data.size());
+            }
+            m_data = std::move(data);
         }
+        return m_data.data();
+    }
+
+    auto capacity() const -> size_t
+    {
+        return m_data.size();
     }
 
-    std::array<typename MatchClass::Match, MatchClasses> m_matches;
+    auto finish(const size_t size) -> std::span<const uint8_t>
+    {
+        return {m_data.data(), size};
+    }
 
 private:
-    std::array<MatchClass, MatchClasses> m_matchClasses;
-    size_t m_maxMatchLength{0};
+    ByteVector m_data;
 };
 
-template <unsigned int MatchClasses>
-class BruteForceMatcher : public StringMatcher<MatchClass, MatchClasses>
+// Output of LzDecompressor into memory of the caller, e.g. a memory mapped file. Throws if the
+// decompressed data does not fit. Matches may write beyond the end of the data, within capacity.
+class BufferOutput
 {
 public:
-    explicit BruteForceMatcher(const size_t windowLength)
-        : m_windowLength{windowLength}
+    BufferOutput(uint8_t* data, const size_t capacity)
+        : m_data{data}
+        , m_capacity{capacity}
     {
     }
 
-    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    void prepare(const size_t)
     {
-        this->resetMatches();
+    }
 
-        bool matchFound{false};
-        auto const searchLength = std::min(static_cast<size_t>(pos - begin), m_windowLength);
-        auto const lookAheadLength = end - pos;
-        for (size_t offset = 1; offset < searchLength; ++offset)
+    auto reserve(const size_t size) -> uint8_t*
+    {
+        if (size > m_capacity)
         {
-            size_t length;
-            for (length = 0; length < lookAheadLength && length < this->maxMatchLength(); ++length)
-            {
-                if (pos[-offset + length] != pos[length])
-                {
-                    break;
-                }
-            }
-            if (length > 1)
-            {
-                for (unsigned int cls = 0; cls < this->matchClassCount(); ++cls)
-                {
-                    auto const& matchCls = this->matchClass(cls);
-                    if (matchCls.offset.contains(offset) && matchCls.length.contains(length) &&
-                        length > this->m_matches[cls].length)
-                    {
-                        this->m_matches[cls].cls = cls;
-                        this->m_matches[cls].length = length;
-                        this->m_matches[cls].offset = offset;
-                        matchFound = true;
-                    }
-                }
-            }
+            throw std::runtime_error{"BufferOutput: output exceeds the capacity of the buffer"};
         }
+        return m_data;
+    }
 
-        return matchFound;
+    auto capacity() const -> size_t
+    {
+        return m_capacity;
     }
 
-    template <class Iterator> void advance(Iterator, Iterator, Iterator, const size_t)
+    auto finish(const size_t size) -> size_t
     {
+        return size;
     }
 
 private:
-    size_t m_windowLength;
+    uint8_t* m_data{nullptr};
+    size_t m_capacity{0};
 };
 
-template <unsigned int MatchClasses>
-class BinaryTreeMatcher : public StringMatcher<MatchClass, MatchClasses>
+// Decodes tokens of a whole compressed buffer into Output. Matches may reach back into preData,
+// which precedes the decompressed data without being part of it. Safe on invalid input: decoders
+// fetch tokens while canDecode(), and truncated data or matches before the start of the data
+// throw.
+template <bool AllowOverlapping = false, class Output = VectorOutput<>> class LzDecompressor
 {
 public:
-    using Base = StringMatcher<MatchClass, MatchClasses>;
-    using Base::maxMatchLength;
-    using Base::matchClassCount;
-    using Base::resetMatches;
-
-    explicit BinaryTreeMatcher(const size_t windowLength)
-        : m_nodes(windowLength, Node{EmptyNode, EmptyNode, EmptyNode})
+    template <class... Args>
+    explicit LzDecompressor(Args&&... outputArgs)
+        : m_output(std::forward<Args>(outputArgs)...)
     {
     }
 
-    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    // With expectedSize, the size of the decompressed data if known up front, a VectorOutput is
+    // allocated once.
+    void reset(const uint8_t* data, const size_t size, const uint8_t* preData = nullptr,
+               const size_t preSize = 0, const size_t expectedSize = 0)
     {
-        resetMatches();
-
-        bool matchFound{false};
-        auto i = m_root;
-        unsigned int maxedClasses{0};
-        unsigned int tries{0};
+        m_compressed = data;
+        m_size = size;
+        m_position = 0;
+        m_tailOffset = 0;
+        m_preData = preData;
+        m_preSize = preData ? preSize : 0;
+        m_output.prepare(expectedSize);
+        m_decompressedSize = 0;
+    }
 
-        while (i != EmptyNode)
+    void emitMatch(size_t offset, size_t length)
+    {
+        // also catches an offset of 0
+        if (offset - 1 >= m_decompressedSize)
         {
-            auto const offset = nodeIndexToOffset(i);
-            auto const nodePos = pos - offset;
-            auto const patternEnd =
-                pos + std::min(maxMatchLength(), static_cast<size_t>(end - pos));
-            auto const [comparison, length] =
-                compare(pos, patternEnd, nodePos, nodePos + (patternEnd - pos));
-
-            if (length > 1)
+            auto const fromPreData = std::min(offset - m_decompressedSize, length);
+            if (offset == 0 || offset - m_decompressedSize > m_preSize)
             {
-                for (unsigned int cls = 0; cls < this->matchClassCount(); ++cls)
-                {
-                    auto const& matchCls = this->matchClass(cls);
-                    auto const maxMatch = std::min(length, matchCls.length.max);
-                    if (matchCls.offset.contains(offset) && length >= matchCls.length.min &&
-                        maxMatch > this->m_matches[cls].length)
-                    {
-                        this->m_matches[cls].length = maxMatch;
-                        this->m_matches[cls].offset = offset;
-
-                        if (matchCls.length.max == maxMatch)
-                        {
-                            maxedClasses += 1;
-                        }
-                        matchFound = true;
-                    }
-                }
-                if (maxedClasses == matchClassCount())
-                {
-                    break;
-                }
+                throw std::runtime_error{"LzDecompressor: match before the start of the data"};
             }
-
-            if (comparison >= 0)
+            auto* const out = reserve(fromPreData);
+            std::memcpy(out, m_preData + m_preSize - (offset - m_decompressedSize), fromPreData);
+            m_decompressedSize += fromPreData;
+            length -= fromPreData;
+            if (length == 0)
             {
-                i = m_nodes[i].right;
+                // the source may start before the output
+                return;
             }
-            else if (comparison < 0)
+        }
+
+        auto* const out = reserve(length);
+        auto const* const source = out - offset;
+        if constexpr (AllowOverlapping)
+        {
+            if (m_decompressedSize + length + MatchCopySlack <= m_output.capacity())
             {
-                i = m_nodes[i].left;
+                copyMatch(out, offset, length);
             }
-
-            if (tries++ > 4096)
+            else
             {
-                break;
+                for (size_t i = 0; i < length; ++i)
+                {
+                    out[i] = source[i];
+                }
             }
         }
-        return matchFound;
+        else
+        {
+            std::memcpy(out, source, length);
+        }
+        m_decompressedSize += length;
     }
 
-    template <class Iterator>
-    void advance(Iterator begin, Iterator end, Iterator pos, const size_t steps)
+    void emitLiterals(const size_t length)
     {
-        for (size_t i = 0; i < steps; ++i)
+        if (m_position + length > m_size)
         {
-            if (pos - begin >= windowLength())
-            {
-                remove(m_positionBase);
-            }
-
-            insert(begin, end, pos);
-
-            ++pos;
-            m_positionBase = (m_positionBase + 1) % windowLength();
+            throw std::runtime_error{"LzDecompressor: compressed data ends within literals"};
         }
+        std::memcpy(reserve(length), m_compressed + m_position, length);
+        m_decompressedSize += length;
+        m_position += length;
     }
 
-private:
-    static constexpr unsigned int EmptyNode = ~static_cast<unsigned int>(0);
+    void emitLiterals(size_t count, uint8_t value)
+    {
+        std::memset(reserve(count), static_cast<int>(value), count);
+        m_decompressedSize += count;
+    }
 
-    template <class Iterator>
-    auto compare(Iterator begin_a, Iterator end_a, Iterator begin_b, Iterator end_b) const
-        -> std::pair<int, size_t>
+    // Tells whether input is left to decode a token of up to maxTokenLength bytes from. The last
+    // bytes, too few for such a token, are decoded from a zero padded copy, so that fetch() needs
+    // no bounds check; reading into the padding throws here or in finish().
+    bool canDecode(const size_t maxTokenLength)
     {
-        auto const length = static_cast<size_t>(end_a - begin_a);
-        for (size_t i = 0; begin_a != end_a; ++begin_a, ++begin_b, ++i)
+        if (m_position + maxTokenLength <= m_size)
         {
-            auto const result = *begin_a - *begin_b;
-            if (result != 0)
-            {
-                return std::make_pair(result > 0 ? 1 : -1, i);
-            }
+            return true;
         }
-        return std::make_pair(0, length);
+        return canDecodeTail(maxTokenLength);
     }
 
-    template <class Iterator> void insert(Iterator begin, Iterator end, Iterator pos)
+    auto fetch() -> uint8_t
     {
-        if (m_root == EmptyNode)
-        {
-            m_root = m_positionBase;
-            m_nodes[m_positionBase].parent = EmptyNode;
-            return;
-        }
+        return m_compressed[m_position++];
+    }
 
-        const size_t searchLength = pos - begin;
-        const size_t matchLength = std::min(static_cast<size_t>(end - pos), maxMatchLength());
+    // Returns the next four bytes of input, the first one in the lowest bits, without consuming
+    // them. Requires canDecode(4).
+    auto peek() const -> uint32_t
+    {
+        return loadLittleEndian32(m_compressed + m_position);
+    }
 
-        auto i = m_root;
-        while (true)
-        {
-            auto const offset = nodeIndexToOffset(i);
-            auto const nodePos = pos - offset;
-            auto const [result, length] =
-                compare(pos, pos + matchLength, nodePos, nodePos + matchLength);
-            if (result == 0)
-            {
-                replace(i, m_positionBase);
-                setRight(m_positionBase, i);
-                setLeft(m_positionBase, m_nodes[i].left);
-                setLeft(i, EmptyNode);
-                return;
-            }
-            else if (result > 0)
-            {
+    void skip(const size_t count)
+    {
+        m_position += count;
+    }
+
+    // Returns the number of bytes of input left.
+    auto available() const -> size_t
+    {
+        return m_size - std::min(m_position, m_size);
+    }
+
+    bool isAtEnd() const
+    {
+        return m_position >= m_size;
+    }
+
+    // Returns what Output::finish() returns: the decompressed data, a reference to it, or its size.
+    decltype(auto) finish()
+    {
+        checkTruncation();
+        return m_output.finish(m_decompressedSize);
+    }
+
+    auto position() const -> size_t
+    {
+        return m_tailOffset + m_position;
+    }
+
+    auto decompressedPosition() const -> size_t
+    {
+        return m_decompressedSize;
+    }
+
+private:
+    // longest token canDecode() can be asked for
+    static constexpr size_t MaxTokenLength = 16;
+
+    // Returns where to write the next length bytes.
+    auto reserve(const size_t length) -> uint8_t*
+    {
+        return m_output.reserve(m_decompressedSize + length) + m_decompressedSize;
+    }
+
+    bool canDecodeTail(const size_t maxTokenLength)
+    {
+        checkTruncation();
+        if (maxTokenLength > MaxTokenLength)
+        {
+            throw std::logic_error{"LzDecompressor: tokens too long for the padded tail"};
+        }
+        if (m_compressed != m_tail.data())
+        {
+            auto const remaining = m_size - m_position;
+            m_tail.fill(0);
+            if (remaining > 0)
+            {
+                std::memcpy(m_tail.data(), m_compressed + m_position, remaining);
+            }
+            m_compressed = m_tail.data();
+            m_tailOffset = m_position;
+            m_size = remaining;
+            m_position = 0;
+        }
+        return m_position < m_size;
+    }
+
+    void checkTruncation() const
+    {
+        if (m_position > m_size)
+        {
+            throw std::runtime_error{"LzDecompressor: compressed data ends within a token"};
+        }
+    }
+
+    const uint8_t* m_compressed{nullptr};
+    size_t m_size{0};
+    size_t m_position{0};
+    // the last bytes of the input, followed by zeros
+    std::array<uint8_t, 2 * MaxTokenLength> m_tail{};
+    size_t m_tailOffset{0};
+    const uint8_t* m_preData{nullptr};
+    size_t m_preSize{0};
+    Output m_output;
+    size_t m_decompressedSize{0};
+};
+
+// Stands in for LzDecompressor to compute the size of the decompressed data without producing it.
+// Checks that tokens and literals stay within the compressed data and that matches stay within the
+// decompressed data and preData; throws if not.
+class LzSizeScanner
+{
+public:
+    void reset(const uint8_t* data, const size_t size, const uint8_t* preData = nullptr,
+               const size_t preSize = 0, const size_t = 0)
+    {
+        m_compressed = data;
+        m_size = size;
+        m_position = 0;
+        m_preSize = preData ? preSize : 0;
+        m_decompressedSize = 0;
+    }
+
+    void emitMatch(const size_t offset, const size_t length)
+    {
+        if (offset == 0 || offset > m_decompressedSize + m_preSize)
+        {
+            throw std::runtime_error{"LzSizeScanner: match outside of the decompressed data"};
+        }
+        m_decompressedSize += length;
+    }
+
+    void emitLiterals(const size_t length)
+    {
+        if (length > m_size - m_position)
+        {
+            throw std::runtime_error{"LzSizeScanner: literals beyond the end of the input"};
+        }
+        m_decompressedSize += length;
+        m_position += length;
+    }
+
+    void emitLiterals(size_t count, uint8_t)
+    {
+        m_decompressedSize += count;
+    }
+
+    bool canDecode(const size_t)
+    {
+        return m_position < m_size;
+    }
+
+    auto fetch() -> uint8_t
+    {
+        if (m_position >= m_size)
+        {
+            throw std::runtime_error{"LzSizeScanner: token beyond the end of the input"};
+        }
+        return m_compressed[m_position++];
+    }
+
+    // Returns the next four bytes of input, the first one in the lowest bits and zeros beyond the
+    // end of the input, without consuming them.
+    auto peek() const -> uint32_t
+    {
+        if (m_position + 4 <= m_size)
+        {
+            return loadLittleEndian32(m_compressed + m_position);
+        }
+        uint32_t word = 0;
+        for (size_t i = 0; m_position + i < m_size; ++i)
+        {
+            word |= static_cast<uint32_t>(m_compressed[m_position + i]) << (8 * i);
+        }
+        return word;
+    }
+
+    void skip(const size_t count)
+    {
+        if (count > m_size - m_position)
+        {
+            throw std::runtime_error{"LzSizeScanner: token beyond the end of the input"};
+        }
+        m_position += count;
+    }
+
+    auto available() const -> size_t
+    {
+        return m_size - m_position;
+    }
+
+    bool isAtEnd() const
+    {
+        return m_position >= m_size;
+    }
+
+    // Returns the size of the decompressed data.
+    auto finish() -> size_t
+    {
+        return m_decompressedSize;
+    }
+
+    auto position() const -> size_t
+    {
+        return m_position;
+    }
+
+    auto decompressedPosition() const -> size_t
+    {
+        return m_decompressedSize;
+    }
+
+private:
+    const uint8_t* m_compressed{nullptr};
+    size_t m_size{0};
+    size_t m_position{0};
+    size_t m_preSize{0};
+    size_t m_decompressedSize{0};
+};
+
+// Receives decompressed data in chunks.
+using ChunkCallback = std::function<void(const uint8_t* data, size_t size)>;
+
+// Like LzDecompressor, but with compressed input fed in chunks and decompressed output passed to a
+// callback in chunks, keeping only a window of windowLength bytes to resolve matches against.
+// Decoders fetch one token at a time once canDecode() reports that enough input is buffered for
+// any token; the bytes of a token cut off by the end of a chunk wait for the next one. Literals
+// copied from the input may span chunks.
+template <bool AllowOverlapping = false> class LzStreamDecompressor
+{
+public:
+    LzStreamDecompressor(const size_t windowLength, ChunkCallback callback)
+        : m_windowLength{windowLength}
+        , m_callback{std::move(callback)}
+        , m_buffer(windowLength + std::max(windowLength, FlushLength) + MatchCopySlack)
+    {
+    }
+
+    // The window starts out as preData, which is not passed to the callback.
+    void reset(const uint8_t* preData = nullptr, const size_t preSize = 0)
+    {
+        m_input.clear();
+        m_position = 0;
+        m_pendingLiterals = 0;
+        m_finishing = false;
+        m_size = 0;
+        if (preData && preSize > 0)
+        {
+            auto const kept = std::min(preSize, m_windowLength);
+            std::memcpy(m_buffer.data(), preData + preSize - kept, kept);
+            m_size = kept;
+        }
+        m_flushed = m_size;
+    }
+
+    void feed(const uint8_t* data, const size_t size)
+    {
+        // drop the input consumed so far before it piles up
+        if (m_position > 0 && m_position >= m_input.size() / 2)
+        {
+            m_input.erase(m_input.begin(), m_input.begin() + m_position);
+            m_position = 0;
+        }
+        m_input.insert(m_input.end(), data, data + size);
+    }
+
+    // No more input follows: canDecode() then accepts tokens up to the end of the input.
+    void setFinishing()
+    {
+        m_finishing = true;
+    }
+
+    // Copies pending literals, then tells whether a token of up to maxTokenLength bytes can be
+    // fetched.
+    bool canDecode(const size_t maxTokenLength)
+    {
+        copyPendingLiterals();
+        if (m_pendingLiterals > 0)
+        {
+            return false;
+        }
+        auto const available = m_input.size() - m_position;
+        return available >= maxTokenLength || (m_finishing && available > 0);
+    }
+
+    void emitMatch(const size_t offset, const size_t length)
+    {
+        if (offset == 0 || offset > std::min(m_size, m_windowLength))
+        {
+            throw std::runtime_error{"LzStreamDecompressor: match offset beyond the window"};
+        }
+        reserve(length + MatchCopySlack);
+        auto* out = m_buffer.data() + m_size;
+        if constexpr (AllowOverlapping)
+        {
+            copyMatch(out, offset, length);
+        }
+        else
+        {
+            std::memcpy(out, out - offset, length);
+        }
+        m_size += length;
+    }
+
+    // The literals are copied as the input arrives.
+    void emitLiterals(const size_t length)
+    {
+        m_pendingLiterals += length;
+        copyPendingLiterals();
+    }
+
+    void emitLiterals(const size_t count, const uint8_t value)
+    {
+        reserve(count);
+        std::memset(m_buffer.data() + m_size, static_cast<int>(value), count);
+        m_size += count;
+    }
+
+    auto fetch() -> uint8_t
+    {
+        if (m_position >= m_input.size())
+        {
+            throw std::runtime_error{"LzStreamDecompressor: compressed data ends within a token"};
+        }
+        return m_input[m_position++];
+    }
+
+    // Returns the next four bytes of input, the first one in the lowest bits and zeros beyond the
+    // end of the input, without consuming them.
+    auto peek() const -> uint32_t
+    {
+        if (m_position + 4 <= m_input.size())
+        {
+            return loadLittleEndian32(m_input.data() + m_position);
+        }
+        uint32_t word = 0;
+        for (size_t i = 0; m_position + i < m_input.size(); ++i)
+        {
+            word |= static_cast<uint32_t>(m_input[m_position + i]) << (8 * i);
+        }
+        return word;
+    }
+
+    void skip(const size_t count)
+    {
+        if (count > m_input.size() - m_position)
+        {
+            throw std::runtime_error{"LzStreamDecompressor: compressed data ends within a token"};
+        }
+        m_position += count;
+    }
+
+    // Passes the rest of the output to the callback. Throws if literals are still missing.
+    void finish()
+    {
+        if (m_pendingLiterals > 0)
+        {
+            throw std::runtime_error{"LzStreamDecompressor: compressed data ends within literals"};
+        }
+        flush();
+    }
+
+private:
+    // output collected before it is passed to the callback
+    static constexpr size_t FlushLength = size_t{1} << 16;
+
+    void copyPendingLiterals()
+    {
+        while (m_pendingLiterals > 0 && m_position < m_input.size())
+        {
+            auto const length = std::min({m_pendingLiterals, m_input.size() - m_position,
+                                          m_buffer.size() - m_windowLength - MatchCopySlack});
+            reserve(length);
+            std::memcpy(m_buffer.data() + m_size, m_input.data() + m_position, length);
+            m_size += length;
+            m_position += length;
+            m_pendingLiterals -= length;
+        }
+    }
+
+    // Makes room for length more bytes of output, by passing the output on and sliding the
+    // window to the front of the buffer.
+    void reserve(const size_t length)
+    {
+        if (m_size + length <= m_buffer.size())
+        {
+            return;
+        }
+        if (m_windowLength + length > m_buffer.size())
+        {
+            m_buffer.resize(m_windowLength + length);
+        }
+        flush();
+        auto const kept = std::min(m_size, m_windowLength);
+        std::memmove(m_buffer.data(), m_buffer.data() + m_size - kept, kept);
+        m_size = m_flushed = kept;
+    }
+
+    void flush()
+    {
+        if (m_size > m_flushed)
+        {
+            m_callback(m_buffer.data() + m_flushed, m_size - m_flushed);
+            m_flushed = m_size;
+        }
+    }
+
+    size_t m_windowLength;
+    ChunkCallback m_callback;
+    // the window followed by the output not passed on yet
+    std::vector<uint8_t> m_buffer;
+    size_t m_size{0};
+    size_t m_flushed{0};
+    std::vector<uint8_t> m_input;
+    size_t m_position{0};
+    size_t m_pendingLiterals{0};
+    bool m_finishing{false};
+};
+
+// Output sinks, for processors to write their output into. A processor writes whole tokens or
+// runs of literals with write() and calls finish() at the end of its output.
+
+// Collects the output in a vector.
+class VectorSink
+{
+public:
+    void write(const uint8_t* data, const size_t size)
+    {
+        m_data.insert(m_data.end(), data, data + size);
+    }
+
+    void finish()
+    {
+    }
+
+    auto size() const -> size_t
+    {
+        return m_data.size();
+    }
+
+    auto take() -> std::vector<uint8_t>
+    {
+        return std::move(m_data);
+    }
+
+    auto data() const -> const std::vector<uint8_t>&
+    {
+        return m_data;
+    }
+
+    // Empties the sink for the next output, keeping its memory.
+    void clear()
+    {
+        m_data.clear();
+    }
+
+private:
+    std::vector<uint8_t> m_data;
+};
+
+// Writes the output into a preallocated buffer. Throws if it does not fit.
+class BufferSink
+{
+public:
+    BufferSink(uint8_t* data, const size_t capacity)
+        : m_data{data}
+        , m_capacity{capacity}
+    {
+    }
+
+    void write(const uint8_t* data, const size_t size)
+    {
+        if (size > m_capacity - m_size)
+        {
+            throw std::runtime_error{"BufferSink: output exceeds the capacity of the buffer"};
+        }
+        std::memcpy(m_data + m_size, data, size);
+        m_size += size;
+    }
+
+    void finish()
+    {
+    }
+
+    auto size() const -> size_t
+    {
+        return m_size;
+    }
+
+private:
+    uint8_t* m_data{nullptr};
+    size_t m_capacity{0};
+    size_t m_size{0};
+};
+
+// Passes the output to a callback in chunks of up to chunkLength bytes, e.g. to write it to a file.
+class CallbackSink
+{
+public:
+    explicit CallbackSink(ChunkCallback callback, const size_t chunkLength = size_t{1} << 16)
+        : m_callback{std::move(callback)}
+        , m_chunkLength{chunkLength}
+    {
+        m_buffer.reserve(chunkLength);
+    }
+
+    void write(const uint8_t* data, const size_t size)
+    {
+        m_size += size;
+        if (m_buffer.size() + size > m_chunkLength)
+        {
+            flush();
+            if (size >= m_chunkLength)
+            {
+                m_callback(data, size);
+                return;
+            }
+        }
+        m_buffer.insert(m_buffer.end(), data, data + size);
+    }
+
+    void finish()
+    {
+        flush();
+    }
+
+    auto size() const -> size_t
+    {
+        return m_size;
+    }
+
+private:
+    void flush()
+    {
+        if (!m_buffer.empty())
+        {
+            m_callback(m_buffer.data(), m_buffer.size());
+            m_buffer.clear();
+        }
+    }
+
+    ChunkCallback m_callback;
+    size_t m_chunkLength;
+    std::vector<uint8_t> m_buffer;
+    size_t m_size{0};
+};
+
+struct Match
+{
+    size_t cls;
+    size_t offset;
+    size_t length;
+
+    bool isValid() const
+    {
+        return length > 0;
+    }
+
+    void reset()
+    {
+        offset = 0;
+        length = 0;
+    }
+};
+
+struct Range
+{
+    size_t min{0};
+    size_t max{0};
+
+    bool contains(const size_t value) const
+    {
+        return value >= min && value <= max;
+    }
+};
+
+struct MatchClass
+{
+    using Match = squeeze::Match;
+
+    size_t overhead{0};
+    Range length;
+    Range offset;
+    // encoded size of a match in bits; if zero, (overhead + 1) bytes are assumed
+    size_t cost{0};
+
+    auto quality(const Match& match) const -> int
+    {
+        return match.length - overhead;
+    }
+
+    auto price(const Match&) const -> size_t
+    {
+        return cost != 0 ? cost : 8 * (overhead + 1);
+    }
+};
+
+struct SearchEffort
+{
+    // maximum number of candidates (tree nodes, chain links) examined per position
+    unsigned int maxTries{4096};
+    // stop searching once every match class has a match of at least this length (or of its
+    // maximum length)
+    size_t goodLength{std::numeric_limits<size_t>::max()};
+};
+
+// Which of the positions covered by a match BinaryTreeMatcher inserts (see advanceMatch()).
+// Matches of up to fullLength bytes are inserted completely. Of longer ones, only every stride-th
+// position and the last stride - 1 positions are inserted, which trades ratio for speed on
+// repetitive data.
+struct InsertionPolicy
+{
+    size_t fullLength{std::numeric_limits<size_t>::max()};
+    size_t stride{1};
+
+    auto inserts(const size_t index, const size_t matchLength) const -> bool
+    {
+        return matchLength <= fullLength || stride <= 1 || index % stride == 0 ||
+               index + stride > matchLength;
+    }
+};
+
+template <class _MatchClass, unsigned int MatchClasses> class StringMatcher
+{
+public:
+    using MatchClass = _MatchClass;
+    using Match = typename MatchClass::Match;
+    using Matches = std::array<Match, MatchClasses>;
+
+    constexpr auto matchClassCount() const -> unsigned int
+    {
+        return MatchClasses;
+    }
+
+    void configureMatchClass(const unsigned int index, const MatchClass& matchClass)
+    {
+        m_matchClasses[index] = matchClass;
+
+        m_maxMatchLength = 0;
+        for (auto const& cls : m_matchClasses)
+        {
+            m_maxMatchLength = std::max(m_maxMatchLength, cls.length.max);
+        }
+    }
+
+    auto matchClass(const unsigned int index) const -> const MatchClass&
+    {
+        return m_matchClasses[index];
+    }
+
+    auto match(const unsigned int index) const -> const typename MatchClass::Match&
+    {
+        return m_matches[index];
+    }
+
+    auto matches() const -> const Matches&
+    {
+        return m_matches;
+    }
+
+    auto bestMatch() const -> unsigned int
+    {
+        return bestMatch(m_matches);
+    }
+
+    // The class of the best of the given matches, which were found by this matcher.
+    auto bestMatch(const Matches& matches) const -> unsigned int
+    {
+        unsigned int best_i{0};
+        int quality{0};
+        for (unsigned int i = 0; i < matchClassCount(); ++i)
+        {
+            if (matches[i].isValid())
+            {
+                auto const thisQuality = matchClass(i).quality(matches[i]);
+                if (thisQuality > quality)
+                {
+                    best_i = i;
+                    quality = thisQuality;
+                }
+            }
+        }
+        return best_i;
+    }
+
+    auto maxMatchLength() const -> size_t
+    {
+        return m_maxMatchLength;
+    }
+
+protected:
+    static constexpr unsigned int AllClasses = (1u << MatchClasses) - 1;
+
+    void resetMatches()
+    {
+        for (auto& match : m_matches)
+        {
+            match.reset();
+        }
+    }
+
+    // Offers a match of the given offset and length to all match classes. Every class it improves
+    // keeps it; classes that now have a match of at least goodLength are added to the satisfied
+    // bit mask. Returns whether any class took the match.
+    bool offerMatch(const size_t offset, const size_t length, const size_t goodLength,
+                    unsigned int& satisfied)
+    {
+        bool taken{false};
+        for (unsigned int cls = 0; cls < MatchClasses; ++cls)
+        {
+            auto const& matchCls = m_matchClasses[cls];
+            auto const maxMatch = std::min(length, matchCls.length.max);
+            if (matchCls.offset.contains(offset) && length >= matchCls.length.min &&
+                maxMatch > m_matches[cls].length)
+            {
+                m_matches[cls].cls = cls;
+                m_matches[cls].length = maxMatch;
+                m_matches[cls].offset = offset;
+
+                if (maxMatch >= std::min(goodLength, matchCls.length.max))
+                {
+                    satisfied |= 1u << cls;
+                }
+                taken = true;
+            }
+        }
+        return taken;
+    }
+
+    Matches m_matches;
+
+private:
+    std::array<MatchClass, MatchClasses> m_matchClasses;
+    size_t m_maxMatchLength{0};
+};
+
+template <unsigned int MatchClasses>
+class BruteForceMatcher : public StringMatcher<MatchClass, MatchClasses>
+{
+public:
+    explicit BruteForceMatcher(const size_t windowLength)
+        : m_windowLength{windowLength}
+    {
+    }
+
+    auto windowLength() const -> size_t
+    {
+        return m_windowLength;
+    }
+
+    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    {
+        this->resetMatches();
+
+        // every offset of the window, with matches cut to the longest length of a class as the
+        // other matchers do
+        bool matchFound{false};
+        unsigned int satisfied{0};
+        auto const searchLength = std::min(static_cast<size_t>(pos - begin), m_windowLength);
+        auto const maxLength = std::min(this->maxMatchLength(), static_cast<size_t>(end - pos));
+        for (size_t offset = 1; offset <= searchLength; ++offset)
+        {
+            auto const length = matchLength(pos, pos - offset, maxLength);
+            if (length > 1)
+            {
+                matchFound |= this->offerMatch(offset, length,
+                                               std::numeric_limits<size_t>::max(), satisfied);
+            }
+        }
+
+        return matchFound;
+    }
+
+    template <class Iterator> void advance(Iterator, Iterator, Iterator, const size_t)
+    {
+    }
+
+    void rebase(const size_t)
+    {
+    }
+
+    void reset()
+    {
+    }
+
+private:
+    size_t m_windowLength;
+};
+
+// Keeps the strings of the window in a binary search tree. With RootHashBytes = 0 there is a
+// single tree; with 2 or 3, there is one tree per hash of the first RootHashBytes bytes, so that
+// only strings with (most likely) the same prefix share a tree. There are 2^rootHashBits trees;
+// by default about one per position of the window, from 2^8 to 2^16, so that small windows do not
+// pay for a table of roots they cannot fill.
+// Nodes link each other with indices of type Index: uint16_t halves the tree of a window of up to
+// 65533 bytes, so that more of it stays in cache. With KeyBytes = 4 or 8, every node also keeps
+// the first bytes of its string, so that comparisons that differ within them do not read the
+// input at the node's position.
+template <unsigned int MatchClasses, unsigned int RootHashBytes = 0, class Index = unsigned int,
+          unsigned int KeyBytes = 0>
+class BinaryTreeMatcher : public StringMatcher<MatchClass, MatchClasses>
+{
+    static_assert(RootHashBytes == 0 || RootHashBytes == 2 || RootHashBytes == 3,
+                  "BinaryTreeMatcher: RootHashBytes must be 0, 2 or 3");
+    static_assert(std::is_unsigned_v<Index>, "BinaryTreeMatcher: Index must be unsigned");
+    static_assert(KeyBytes == 0 || KeyBytes == 4 || KeyBytes == 8,
+                  "BinaryTreeMatcher: KeyBytes must be 0, 4 or 8");
+
+public:
+    using Base = StringMatcher<MatchClass, MatchClasses>;
+    using Base::maxMatchLength;
+    using Base::matchClassCount;
+    using Base::resetMatches;
+
+    explicit BinaryTreeMatcher(const size_t windowLength, const unsigned int rootHashBits = 0)
+        : m_rootHashBits{rootHashBits != 0 ? rootHashBits : defaultRootHashBits(windowLength)}
+        , m_nodes(windowLength, unusedNode())
+        , m_roots(RootHashBytes == 0 ? 1 : size_t{1} << m_rootHashBits, EmptyNode)
+    {
+        if (windowLength >= UnusedNode)
+        {
+            throw std::runtime_error{"BinaryTreeMatcher: window too large for the node indices"};
+        }
+        if (RootHashBytes != 0 && m_rootHashBits > 8 * RootHashBytes)
+        {
+            throw std::runtime_error{"BinaryTreeMatcher: more root hash bits than hashed bits"};
+        }
+    }
+
+    auto windowLength() const -> size_t
+    {
+        return m_nodes.size();
+    }
+
+    auto searchEffort() const -> const SearchEffort&
+    {
+        return m_effort;
+    }
+
+    void setSearchEffort(const SearchEffort& effort)
+    {
+        m_effort = effort;
+    }
+
+    // With fused insertion, findMatches() also inserts pos into the tree while descending it, and
+    // the following advance() skips pos. Each position then costs one descent instead of two. This
+    // requires findMatches() to be called in order and before pos is advanced over; a match at
+    // offset windowLength() is not found, since the oldest string leaves the tree first.
+    auto fusedInsertion() const -> bool
+    {
+        return m_fusedInsertion;
+    }
+
+    void setFusedInsertion(const bool fused)
+    {
+        m_fusedInsertion = fused;
+    }
+
+    auto insertionPolicy() const -> const InsertionPolicy&
+    {
+        return m_insertion;
+    }
+
+    void setInsertionPolicy(const InsertionPolicy& insertion)
+    {
+        m_insertion = insertion;
+    }
+
+    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    {
+        if (m_fusedInsertion && static_cast<size_t>(pos - begin) == m_inserted)
+        {
+            resetMatches();
+            return insertNext<true>(begin, end, pos);
+        }
+
+        resetMatches();
+        unsigned int satisfied{0};
+        unsigned int tries{0};
+        return search(end, pos, m_roots[bucket(pos, end)], satisfied, tries);
+    }
+
+    template <class Iterator>
+    void advance(Iterator begin, Iterator end, Iterator pos, const size_t steps)
+    {
+        for (size_t i = 0; i < steps; ++i, ++pos)
+        {
+            // already inserted by findMatches()
+            if (static_cast<size_t>(pos - begin) < m_inserted)
+            {
+                continue;
+            }
+
+            insertNext<false>(begin, end, pos);
+        }
+    }
+
+    // Like advance(), for the positions covered by a match starting at pos. Positions the
+    // insertion policy leaves out still take up their slot in the window, but not in the tree.
+    template <class Iterator>
+    void advanceMatch(Iterator begin, Iterator end, Iterator pos, const size_t steps)
+    {
+        for (size_t i = 0; i < steps; ++i, ++pos)
+        {
+            if (static_cast<size_t>(pos - begin) < m_inserted)
+            {
+                continue;
+            }
+
+            if (m_insertion.inserts(i, steps))
+            {
+                insertNext<false>(begin, end, pos);
+            }
+            else
+            {
+                skipNext(begin, end, pos);
+            }
+        }
+    }
+
+    // Moves the start of the buffer distance bytes forward, for streaming. The nodes only store
+    // offsets, so just the count of inserted positions changes. The window before the next
+    // position must stay in the buffer.
+    void rebase(const size_t distance)
+    {
+        m_inserted -= distance;
+    }
+
+    // Empties the window, for a new stream.
+    void reset()
+    {
+        std::fill(m_nodes.begin(), m_nodes.end(), unusedNode());
+        std::fill(m_roots.begin(), m_roots.end(), EmptyNode);
+        m_positionBase = 0;
+        m_inserted = 0;
+    }
+
+private:
+    static constexpr Index EmptyNode = std::numeric_limits<Index>::max();
+    // parent of a slot whose position was skipped or not reached yet, so is not part of any tree
+    static constexpr Index UnusedNode = EmptyNode - 1;
+
+    static auto defaultRootHashBits(const size_t windowLength) -> unsigned int
+    {
+        auto const bits = static_cast<unsigned int>(std::bit_width(windowLength - 1));
+        return std::clamp(bits, 8u, 16u);
+    }
+
+    // the first KeyBytes bytes of a string, the first one in the highest bits, so that keys
+    // compare like the strings
+    using Key = std::conditional_t<KeyBytes == 8, uint64_t, uint32_t>;
+
+    // Index of the tree the string at pos belongs to. Strings too short to be hashed completely
+    // are hashed as if padded with zeros.
+    template <class Iterator> auto bucket(Iterator pos, Iterator end) const -> size_t
+    {
+        if constexpr (RootHashBytes == 0)
+        {
+            return 0;
+        }
+        else
+        {
+            auto const available = std::min(static_cast<size_t>(end - pos), size_t{RootHashBytes});
+            uint32_t value{0};
+            for (size_t i = 0; i < RootHashBytes; ++i)
+            {
+                value = (value << 8) | (i < available ? static_cast<uint8_t>(pos[i]) : 0);
+            }
+            // two bytes fit in 16 bits as they are
+            if (RootHashBytes == 2 && m_rootHashBits == 16)
+            {
+                return value;
+            }
+            return static_cast<uint32_t>(value * 2654435761u) >> (32 - m_rootHashBits);
+        }
+    }
+
+    // Returns the key of the string at pos, or 0 if it is shorter than KeyBytes.
+    template <class Iterator> auto key(Iterator pos, Iterator end) const -> Key
+    {
+        Key value{0};
+        if (static_cast<size_t>(end - pos) >= KeyBytes)
+        {
+            for (size_t i = 0; i < KeyBytes; ++i)
+            {
+                value = (value << 8) | static_cast<uint8_t>(pos[i]);
+            }
+        }
+        return value;
+    }
+
+    // Compares the string at pos with that of node i at nodePos over length bytes, like
+    // compareStrings(). patternKey is the key of the string at pos.
+    template <class Iterator>
+    auto compare(Iterator pos, Iterator nodePos, const size_t length, const Index i,
+                 [[maybe_unused]] const Key patternKey) const -> std::pair<int, size_t>
+    {
+        if constexpr (KeyBytes > 0)
+        {
+            auto const& node = m_nodes[i];
+            if (node.keyed && length >= KeyBytes)
+            {
+                if (patternKey != node.key)
+                {
+                    auto const common = std::countl_zero(patternKey ^ node.key) / 8;
+                    return std::make_pair(patternKey > node.key ? 1 : -1,
+                                          static_cast<size_t>(common));
+                }
+                auto const [sign, common] =
+                    compareStrings(pos + KeyBytes, nodePos + KeyBytes, length - KeyBytes);
+                return std::make_pair(sign, KeyBytes + common);
+            }
+        }
+        return compareStrings(pos, nodePos, length);
+    }
+
+    // Offers the strings of the subtree i to the match classes, descending towards pos.
+    template <class Iterator>
+    bool search(Iterator end, Iterator pos, Index i, unsigned int& satisfied, unsigned int& tries)
+    {
+        bool matchFound{false};
+        auto const patternLength = std::min(maxMatchLength(), static_cast<size_t>(end - pos));
+        auto const patternKey = key(pos, end);
+
+        while (i != EmptyNode)
+        {
+            auto const offset = nodeIndexToOffset(i);
+            auto const nodePos = pos - offset;
+            auto const [comparison, length] = compare(pos, nodePos, patternLength, i, patternKey);
+
+            if (length > 1)
+            {
+                matchFound |= this->offerMatch(offset, length, m_effort.goodLength, satisfied);
+                if (satisfied == Base::AllClasses)
+                {
+                    break;
+                }
+            }
+
+            if (comparison >= 0)
+            {
+                i = m_nodes[i].right;
+            }
+            else if (comparison < 0)
+            {
+                i = m_nodes[i].left;
+            }
+
+            if (++tries >= m_effort.maxTries)
+            {
+                break;
+            }
+        }
+        return matchFound;
+    }
+
+    // Drops the string leaving the window and inserts the one at pos. With Search, the strings
+    // passed on the way down are offered to the match classes like search() would.
+    template <bool Search, class Iterator>
+    bool insertNext(Iterator begin, Iterator end, Iterator pos)
+    {
+        expire(begin, end, pos);
+
+        // A string too short to be hashed completely is left out: if the buffer grew later, as
+        // when streaming, it would be expired from another tree than the one it is in.
+        bool matchFound{false};
+        if (static_cast<size_t>(end - pos) < RootHashBytes)
+        {
+            if constexpr (Search)
+            {
+                unsigned int satisfied{0};
+                unsigned int tries{0};
+                matchFound = search(end, pos, m_roots[bucket(pos, end)], satisfied, tries);
+            }
+            m_nodes[m_positionBase] = unusedNode();
+        }
+        else
+        {
+            matchFound = insert<Search>(end, pos);
+        }
+
+        m_inserted = static_cast<size_t>(pos - begin) + 1;
+        m_positionBase = (m_positionBase + 1) % windowLength();
+        return matchFound;
+    }
+
+    // Moves the window over pos without inserting it.
+    template <class Iterator> void skipNext(Iterator begin, Iterator end, Iterator pos)
+    {
+        expire(begin, end, pos);
+        m_nodes[m_positionBase] = unusedNode();
+
+        m_inserted = static_cast<size_t>(pos - begin) + 1;
+        m_positionBase = (m_positionBase + 1) % windowLength();
+    }
+
+    template <class Iterator> void expire(Iterator begin, Iterator end, Iterator pos)
+    {
+        if (static_cast<size_t>(pos - begin) >= windowLength() &&
+            m_nodes[m_positionBase].parent != UnusedNode)
+        {
+            auto& root = m_roots[bucket(pos - windowLength(), end)];
+            remove(static_cast<Index>(m_positionBase), root);
+        }
+    }
+
+    template <bool Search, class Iterator> bool insert(Iterator end, Iterator pos)
+    {
+        auto const node = static_cast<Index>(m_positionBase);
+        auto const patternKey = key(pos, end);
+        if constexpr (KeyBytes > 0)
+        {
+            m_nodes[node].key = patternKey;
+            m_nodes[node].keyed = static_cast<size_t>(end - pos) >= KeyBytes;
+        }
+
+        auto& root = m_roots[bucket(pos, end)];
+        if (root == EmptyNode)
+        {
+            root = node;
+            m_nodes[node].parent = EmptyNode;
+            return false;
+        }
+
+        const size_t matchLength = std::min(static_cast<size_t>(end - pos), maxMatchLength());
+
+        bool matchFound{false};
+        bool searching{Search};
+        unsigned int satisfied{0};
+        unsigned int tries{0};
+
+        auto i = root;
+        while (true)
+        {
+            auto const offset = nodeIndexToOffset(i);
+            auto const nodePos = pos - offset;
+            auto const [result, length] = compare(pos, nodePos, matchLength, i, patternKey);
+            if (searching && length > 1)
+            {
+                matchFound |= this->offerMatch(offset, length, m_effort.goodLength, satisfied);
+                searching = satisfied != Base::AllClasses;
+            }
+
+            if (result == 0)
+            {
+                replace(i, node, root);
+                setRight(node, i);
+                setLeft(node, m_nodes[i].left);
+                setLeft(i, EmptyNode);
+                // a plain search would go on into the right subtree of the replaced string
+                if (searching && ++tries < m_effort.maxTries)
+                {
+                    matchFound |= search(end, pos, m_nodes[i].right, satisfied, tries);
+                }
+                return matchFound;
+            }
+            else if (result > 0)
+            {
                 if (m_nodes[i].hasRight())
                 {
-                    i = m_nodes[i].right;
+                    i = m_nodes[i].right;
+                }
+                else
+                {
+                    setRight(i, node);
+                    return matchFound;
+                }
+            }
+            else
+            {
+                if (m_nodes[i].hasLeft())
+                {
+                    i = m_nodes[i].left;
+                }
+                else
+                {
+                    setLeft(i, node);
+                    return matchFound;
+                }
+            }
+
+            if (searching && ++tries >= m_effort.maxTries)
+            {
+                searching = false;
+            }
+        }
+    }
+
+    auto inorderPredecessor(const Index n) const -> Index
+    {
+        auto min = n;
+        while (true)
+        {
+            if (m_nodes[min].left == EmptyNode)
+            {
+                return min;
+            }
+            else
+            {
+                min = m_nodes[min].left;
+            }
+        }
+    }
+
+    void remove(const Index n, Index& root)
+    {
+        auto const toDelete = n;
+        Index replacement;
+        if (!m_nodes[toDelete].hasLeft())
+        {
+            replacement = m_nodes[toDelete].right;
+        }
+        else if (!m_nodes[toDelete].hasRight())
+        {
+            replacement = m_nodes[toDelete].left;
+        }
+        else
+        {
+            replacement = inorderPredecessor(m_nodes[toDelete].right);
+            setLeft(replacement, m_nodes[toDelete].left);
+            if (replacement != m_nodes[toDelete].right)
+            {
+                setLeft(m_nodes[replacement].parent, m_nodes[replacement].right);
+                setRight(replacement, m_nodes[toDelete].right);
+            }
+        }
+        replace(toDelete, replacement, root);
+        m_nodes[toDelete].clear();
+    }
+
+    void setLeft(const Index n, const Index left)
+    {
+        m_nodes[n].left = left;
+        if (left != EmptyNode)
+        {
+            m_nodes[left].parent = n;
+        }
+    }
+
+    void setRight(const Index n, const Index right)
+    {
+        m_nodes[n].right = right;
+        if (right != EmptyNode)
+        {
+            m_nodes[right].parent = n;
+        }
+    }
+
+    void replace(const Index n, const Index replacement, Index& root)
+    {
+        if (n != root)
+        {
+            if (m_nodes[m_nodes[n].parent].left == n)
+            {
+                setLeft(m_nodes[n].parent, replacement);
+            }
+            else
+            {
+                setRight(m_nodes[n].parent, replacement);
+            }
+        }
+        else
+        {
+            root = replacement;
+            if (replacement != EmptyNode)
+            {
+                m_nodes[replacement].parent = EmptyNode;
+            }
+        }
+    }
+
+    auto nodeIndexToOffset(const Index i) const -> size_t
+    {
+        return ((m_positionBase + windowLength() - i - 1) % windowLength()) + 1;
+        // auto const offset =
+        // m_positionPos > i ? (m_positionBase - i) : (windowLength() + (m_positionBase - i));
+    }
+
+    struct Node
+    {
+        Index left{0}, right{0};
+        Index parent{0};
+
+        void clear()
+        {
+            left = right = parent = EmptyNode;
+        }
+
+        bool hasLeft() const
+        {
+            return left != EmptyNode;
+        }
+
+        bool hasRight() const
+        {
+            return right != EmptyNode;
+        }
+    };
+
+    struct KeyedNode : Node
+    {
+        Key key{0};
+        // whether the string was at least KeyBytes long when inserted
+        bool keyed{false};
+    };
+
+    using Slot = std::conditional_t<KeyBytes == 0, Node, KeyedNode>;
+
+    static auto unusedNode() -> Slot
+    {
+        Slot slot{};
+        slot.left = slot.right = EmptyNode;
+        slot.parent = UnusedNode;
+        return slot;
+    }
+
+    SearchEffort m_effort;
+    InsertionPolicy m_insertion;
+    unsigned int m_rootHashBits;
+    std::vector<Slot> m_nodes;
+    std::vector<Index> m_roots;
+    size_t m_positionBase{0};
+    size_t m_inserted{0};
+    bool m_fusedInsertion{false};
+};
+
+template <unsigned int MatchClasses>
+class HashChainMatcher : public StringMatcher<MatchClass, MatchClasses>
+{
+public:
+    using Base = StringMatcher<MatchClass, MatchClasses>;
+    using Base::matchClass;
+    using Base::maxMatchLength;
+    using Base::matchClassCount;
+    using Base::resetMatches;
+
+    // hashBits selects the size of the head table (2^hashBits entries, 1 to 32 bits),
+    // maxChainLength how many previous occurrences of a prefix are examined per position
+    // (SearchEffort::maxTries). Both trade ratio for speed. Positions are stored in 32 bits, so
+    // buffers must be shorter than 4 GiB.
+    explicit HashChainMatcher(const size_t windowLength, const unsigned int hashBits = 15,
+                              const unsigned int maxChainLength = 64)
+        : m_hashBits{checkHashBits(hashBits)}
+        , m_effort{maxChainLength}
+        , m_head(size_t{1} << hashBits, EmptyPosition)
+        , m_chain(windowLength, EmptyPosition)
+    {
+    }
+
+    auto windowLength() const -> size_t
+    {
+        return m_chain.size();
+    }
+
+    auto searchEffort() const -> const SearchEffort&
+    {
+        return m_effort;
+    }
+
+    void setSearchEffort(const SearchEffort& effort)
+    {
+        m_effort = effort;
+    }
+
+    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    {
+        resetMatches();
+
+        auto const prefix = prefixLength();
+        if (static_cast<size_t>(end - pos) < prefix)
+        {
+            return false;
+        }
+
+        auto const position = static_cast<size_t>(pos - begin);
+        auto const maxLength = std::min(maxMatchLength(), static_cast<size_t>(end - pos));
+        auto const maxOffset = std::min(maxMatchOffset(), windowLength());
+
+        bool matchFound{false};
+        unsigned int satisfied{0};
+        auto candidate = m_head[hash(pos, prefix)];
+        for (unsigned int tries = 0; candidate != EmptyPosition && tries < m_effort.maxTries;
+             ++tries)
+        {
+            auto const offset = position - candidate;
+            if (candidate >= position || offset > maxOffset)
+            {
+                break;
+            }
+
+            auto const length = matchLength(pos, pos - offset, maxLength);
+            if (length > 1)
+            {
+                matchFound |= this->offerMatch(offset, length, m_effort.goodLength, satisfied);
+                if (satisfied == Base::AllClasses)
+                {
+                    break;
+                }
+            }
+
+            candidate = m_chain[candidate % windowLength()];
+        }
+        return matchFound;
+    }
+
+    template <class Iterator>
+    void advance(Iterator begin, Iterator end, Iterator pos, const size_t steps)
+    {
+        if (static_cast<size_t>(end - begin) >= EmptyPosition)
+        {
+            throw std::runtime_error{"HashChainMatcher: input too large"};
+        }
+
+        auto const prefix = prefixLength();
+        for (size_t i = 0; i < steps; ++i, ++pos)
+        {
+            auto const position = static_cast<uint32_t>(pos - begin);
+            auto& link = m_chain[position % windowLength()];
+            if (static_cast<size_t>(end - pos) < prefix)
+            {
+                link = EmptyPosition;
+                continue;
+            }
+
+            auto& head = m_head[hash(pos, prefix)];
+            link = head;
+            head = position;
+        }
+    }
+
+    // Moves the start of the buffer distance bytes forward, for streaming. Positions before the
+    // new start are dropped from the chains; the window before the next position must stay in the
+    // buffer.
+    void rebase(const size_t distance)
+    {
+        auto const shift = [distance](uint32_t& position) {
+            position = position != EmptyPosition && position >= distance
+                           ? static_cast<uint32_t>(position - distance)
+                           : EmptyPosition;
+        };
+        std::for_each(m_head.begin(), m_head.end(), shift);
+        // the links are indexed by position modulo the window length
+        std::rotate(m_chain.begin(), m_chain.begin() + distance % windowLength(), m_chain.end());
+        std::for_each(m_chain.begin(), m_chain.end(), shift);
+    }
+
+    // Empties the window, for a new stream.
+    void reset()
+    {
+        std::fill(m_head.begin(), m_head.end(), EmptyPosition);
+        std::fill(m_chain.begin(), m_chain.end(), EmptyPosition);
+    }
+
+private:
+    static constexpr uint32_t EmptyPosition = ~static_cast<uint32_t>(0);
+
+    static auto checkHashBits(const unsigned int hashBits) -> unsigned int
+    {
+        if (hashBits == 0 || hashBits > 32)
+        {
+            throw std::runtime_error{"HashChainMatcher: hashBits must be between 1 and 32"};
+        }
+        return hashBits;
+    }
+
+    // Number of bytes that are hashed: the shortest usable match length, but at least two and at
+    // most four bytes.
+    auto prefixLength() const -> size_t
+    {
+        size_t length{4};
+        for (unsigned int cls = 0; cls < matchClassCount(); ++cls)
+        {
+            length = std::min(length, matchClass(cls).length.min);
+        }
+        return std::max(length, size_t{2});
+    }
+
+    auto maxMatchOffset() const -> size_t
+    {
+        size_t offset{0};
+        for (unsigned int cls = 0; cls < matchClassCount(); ++cls)
+        {
+            offset = std::max(offset, matchClass(cls).offset.max);
+        }
+        return offset;
+    }
+
+    template <class Iterator> auto hash(Iterator pos, const size_t prefix) const -> size_t
+    {
+        uint32_t value{0};
+        for (size_t i = 0; i < prefix; ++i)
+        {
+            value = (value << 8) | static_cast<uint8_t>(pos[i]);
+        }
+        return static_cast<uint32_t>(value * 2654435761u) >> (32 - m_hashBits);
+    }
+
+    unsigned int m_hashBits;
+    SearchEffort m_effort;
+    std::vector<uint32_t> m_head;
+    std::vector<uint32_t> m_chain;
+};
+
+// Finds matches with a suffix array of the whole buffer, built on the first search in it. For
+// every match class, the positions in its offset range are kept in a set ordered by suffix array
+// rank. The longest match in the range is with the position of the next lower or higher rank, so
+// every class gets its longest match with two lookups and two comparisons. The buffer must not
+// change while the matcher is used on it. Copies of the matcher share the suffix array.
+// Meant for compress() on a whole buffer only: the suffix array is rebuilt over the whole buffer
+// whenever it changes, so streaming with feed() would rebuild it for every chunk.
+template <unsigned int MatchClasses>
+class SuffixArrayMatcher : public StringMatcher<MatchClass, MatchClasses>
+{
+public:
+    using Base = StringMatcher<MatchClass, MatchClasses>;
+    using Base::matchClass;
+    using Base::maxMatchLength;
+    using Base::matchClassCount;
+    using Base::resetMatches;
+
+    explicit SuffixArrayMatcher(const size_t windowLength)
+        : m_windowLength{windowLength}
+    {
+    }
+
+    auto windowLength() const -> size_t
+    {
+        return m_windowLength;
+    }
+
+    // Builds the suffix array up front, so that copies made afterwards share it.
+    template <class Iterator> void prepare(Iterator begin, Iterator end)
+    {
+        if (begin != end)
+        {
+            index(begin, end);
+        }
+    }
+
+    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    {
+        resetMatches();
+
+        auto const& index = this->index(begin, end);
+        auto const position = static_cast<size_t>(pos - begin);
+        auto const rank = index.ranks[position];
+        auto const maxLength = std::min(maxMatchLength(), static_cast<size_t>(end - pos));
+
+        bool matchFound{false};
+        unsigned int satisfied{0};
+        for (unsigned int cls = 0; cls < matchClassCount(); ++cls)
+        {
+            auto& window = m_windows[cls];
+            slideWindow(window, matchClass(cls).offset, position);
+
+            auto const neighbours = {window.ranks.predecessor(rank), window.ranks.successor(rank)};
+            for (auto const neighbour : neighbours)
+            {
+                if (neighbour == RankSet::None)
+                {
+                    continue;
+                }
+
+                auto const candidate = index.suffixes[neighbour];
+                auto const length = matchLength(pos, begin + candidate, maxLength);
+                if (length > 1)
+                {
+                    matchFound |= this->offerMatch(position - candidate, length,
+                                                   std::numeric_limits<size_t>::max(), satisfied);
+                }
+            }
+        }
+        return matchFound;
+    }
+
+    template <class Iterator>
+    void advance(Iterator begin, Iterator, Iterator pos, const size_t steps)
+    {
+        auto const position = static_cast<size_t>(pos - begin);
+        if (position != m_advanced)
+        {
+            // not continuing where the last call ended, e.g. when primed in the middle of the
+            // buffer: start over with empty windows
+            for (auto& window : m_windows)
+            {
+                for (; m_index && window.tail < window.head; ++window.tail)
+                {
+                    window.ranks.erase(m_index->ranks[window.tail]);
+                }
+                window.tail = window.head = position;
+            }
+            m_from = position;
+        }
+        m_advanced = position + steps;
+    }
+
+    // Moves the start of the buffer distance bytes forward, for streaming. The suffix array is
+    // built anew over the buffer on the next search.
+    void rebase(const size_t distance)
+    {
+        m_index.reset();
+        m_from = m_from > distance ? m_from - distance : 0;
+        m_advanced -= distance;
+    }
+
+    // Empties the windows, for a new stream.
+    void reset()
+    {
+        m_index.reset();
+        m_windows.fill(Window{RankSet{0}, 0, 0});
+        m_from = 0;
+        m_advanced = 0;
+    }
+
+private:
+    // Set of suffix array ranks with fast predecessor and successor lookups: a bit set with a
+    // summary level per 64 words.
+    class RankSet
+    {
+    public:
+        static constexpr size_t None = std::numeric_limits<size_t>::max();
+
+        explicit RankSet(const size_t size = 0)
+        {
+            auto words = std::max((size + 63) / 64, size_t{1});
+            while (true)
+            {
+                m_levels.emplace_back(words, 0);
+                if (words == 1)
+                {
+                    break;
+                }
+                words = (words + 63) / 64;
+            }
+        }
+
+        void insert(size_t i)
+        {
+            for (auto& level : m_levels)
+            {
+                auto const wasEmpty = level[i / 64] == 0;
+                level[i / 64] |= uint64_t{1} << (i % 64);
+                if (!wasEmpty)
+                {
+                    break;
+                }
+                i /= 64;
+            }
+        }
+
+        void erase(size_t i)
+        {
+            for (auto& level : m_levels)
+            {
+                level[i / 64] &= ~(uint64_t{1} << (i % 64));
+                if (level[i / 64] != 0)
+                {
+                    break;
+                }
+                i /= 64;
+            }
+        }
+
+        // largest element below i
+        auto predecessor(size_t i) const -> size_t
+        {
+            size_t level{0};
+            for (;; ++level, i /= 64)
+            {
+                if (level == m_levels.size())
+                {
+                    return None;
+                }
+                auto const word = m_levels[level][i / 64] & ((uint64_t{1} << (i % 64)) - 1);
+                if (word != 0)
+                {
+                    i = (i & ~size_t{63}) | (63 - std::countl_zero(word));
+                    break;
+                }
+            }
+            while (level-- > 0)
+            {
+                i = i * 64 + (63 - std::countl_zero(m_levels[level][i]));
+            }
+            return i;
+        }
+
+        // smallest element above i
+        auto successor(size_t i) const -> size_t
+        {
+            size_t level{0};
+            for (;; ++level, i /= 64)
+            {
+                if (level == m_levels.size())
+                {
+                    return None;
+                }
+                auto const word =
+                    i % 64 == 63 ? 0 : m_levels[level][i / 64] & (~uint64_t{0} << (i % 64 + 1));
+                if (word != 0)
+                {
+                    i = (i & ~size_t{63}) | std::countr_zero(word);
+                    break;
+                }
+            }
+            while (level-- > 0)
+            {
+                i = i * 64 + std::countr_zero(m_levels[level][i]);
+            }
+            return i;
+        }
+
+    private:
+        std::vector<std::vector<uint64_t>> m_levels;
+    };
+
+    // The positions whose offset from the current position is in the range of a match class:
+    // [tail, head).
+    struct Window
+    {
+        RankSet ranks;
+        size_t tail{0};
+        size_t head{0};
+    };
+
+    struct Index
+    {
+        const void* data{nullptr};
+        size_t depth{0};
+        // suffixes sorted by their first depth bytes
+        std::vector<uint32_t> suffixes;
+        // position in suffixes of each suffix
+        std::vector<uint32_t> ranks;
+    };
+
+    void slideWindow(Window& window, const Range& offsets, const size_t position)
+    {
+        auto const maxOffset = std::min(offsets.max, m_windowLength);
+        while (window.head < m_advanced && window.head + offsets.min <= position)
+        {
+            window.ranks.insert(m_index->ranks[window.head++]);
+        }
+        while (window.tail < window.head && window.tail + maxOffset < position)
+        {
+            window.ranks.erase(m_index->ranks[window.tail++]);
+        }
+    }
+
+    template <class Iterator> auto index(Iterator begin, Iterator end) -> const Index&
+    {
+        auto const size = static_cast<size_t>(end - begin);
+        auto const depth = maxMatchLength();
+        if (!m_index || m_index->data != &*begin || m_index->suffixes.size() != size ||
+            m_index->depth != depth)
+        {
+            m_index = buildIndex(begin, size, depth);
+            m_windows.fill(Window{RankSet{size}, m_from, m_from});
+        }
+        return *m_index;
+    }
+
+    // Prefix doubling with radix sorts: after the round with step k, the suffixes are sorted by
+    // their first 2k bytes. Matches are never longer than depth, so sorting stops there.
+    template <class Iterator>
+    static auto buildIndex(Iterator begin, const size_t size, const size_t depth)
+        -> std::shared_ptr<const Index>
+    {
+        if (size > std::numeric_limits<uint32_t>::max())
+        {
+            throw std::runtime_error{"SuffixArrayMatcher: input too large"};
+        }
+
+        auto index = std::make_shared<Index>();
+        index->data = &*begin;
+        index->depth = depth;
+        auto& suffixes = index->suffixes;
+        auto& ranks = index->ranks;
+        suffixes.resize(size);
+        ranks.resize(size);
+
+        std::vector<uint32_t> count(std::max(size, size_t{256}) + 1);
+        for (size_t i = 0; i < size; ++i)
+        {
+            ++count[static_cast<uint8_t>(begin[i]) + 1];
+        }
+        for (size_t c = 1; c <= 256; ++c)
+        {
+            count[c] += count[c - 1];
+        }
+        for (size_t i = 0; i < size; ++i)
+        {
+            suffixes[count[static_cast<uint8_t>(begin[i])]++] = static_cast<uint32_t>(i);
+        }
+
+        size_t groups{0};
+        for (size_t i = 0; i < size; ++i)
+        {
+            if (i > 0 && begin[suffixes[i]] != begin[suffixes[i - 1]])
+            {
+                ++groups;
+            }
+            ranks[suffixes[i]] = static_cast<uint32_t>(groups);
+        }
+        ++groups;
+
+        std::vector<uint32_t> order(size);
+        for (size_t k = 1; k < depth && groups < size; k *= 2)
+        {
+            // order by the second key, the group of the suffix k bytes further; suffixes without
+            // one come first
+            size_t j{0};
+            for (size_t i = size - std::min(k, size); i < size; ++i)
+            {
+                order[j++] = static_cast<uint32_t>(i);
+            }
+            for (size_t i = 0; i < size; ++i)
+            {
+                if (suffixes[i] >= k)
+                {
+                    order[j++] = static_cast<uint32_t>(suffixes[i] - k);
+                }
+            }
+
+            // stable sort by the first key
+            std::fill(count.begin(), count.begin() + groups + 1, 0);
+            for (size_t i = 0; i < size; ++i)
+            {
+                ++count[ranks[i] + 1];
+            }
+            for (size_t g = 1; g <= groups; ++g)
+            {
+                count[g] += count[g - 1];
+            }
+            for (size_t i = 0; i < size; ++i)
+            {
+                suffixes[count[ranks[order[i]]]++] = order[i];
+            }
+
+            // regroup by both keys
+            order.swap(ranks);
+            auto const secondKey = [&](const size_t i) -> size_t {
+                return i + k < size ? order[i + k] + size_t{1} : 0;
+            };
+            groups = 0;
+            for (size_t i = 0; i < size; ++i)
+            {
+                if (i > 0 && (order[suffixes[i]] != order[suffixes[i - 1]] ||
+                              secondKey(suffixes[i]) != secondKey(suffixes[i - 1])))
+                {
+                    ++groups;
+                }
+                ranks[suffixes[i]] = static_cast<uint32_t>(groups);
+            }
+            ++groups;
+        }
+
+        for (size_t i = 0; i < size; ++i)
+        {
+            ranks[suffixes[i]] = static_cast<uint32_t>(i);
+        }
+        return index;
+    }
+
+    size_t m_windowLength;
+    // the positions advanced over: [m_from, m_advanced)
+    size_t m_from{0};
+    size_t m_advanced{0};
+    std::shared_ptr<const Index> m_index;
+    std::array<Window, MatchClasses> m_windows;
+};
+
+struct RleMatch
+{
+    size_t cls;
+    size_t length;
+
+    bool isValid() const
+    {
+        return length != 0;
+    }
+
+    void reset()
+    {
+        length = 0;
+    }
+};
+
+struct RleMatchClass
+{
+    using Match = RleMatch;
+
+    size_t overhead{0};
+    Range length;
+    // encoded size of a match in bits; if zero, (overhead + 1) bytes are assumed
+    size_t cost{0};
+
+    auto quality(const Match& match) const -> size_t
+    {
+        return match.length - overhead;
+    }
+
+    auto price(const Match&) const -> size_t
+    {
+        return cost != 0 ? cost : 8 * (overhead + 1);
+    }
+};
+
+template <unsigned int MatchClasses>
+class RleMatcher : public StringMatcher<RleMatchClass, MatchClasses>
+{
+public:
+    using StringMatcher<RleMatchClass, MatchClasses>::maxMatchLength;
+    using StringMatcher<RleMatchClass, MatchClasses>::matchClass;
+    using StringMatcher<RleMatchClass, MatchClasses>::matchClassCount;
+    using StringMatcher<RleMatchClass, MatchClasses>::resetMatches;
+
+    // runs only refer to the bytes at the current position
+    auto windowLength() const -> size_t
+    {
+        return 0;
+    }
+
+    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    {
+        resetMatches();
+
+        // a run is a string that matches itself shifted by one byte
+        auto const maxLength = std::min(maxMatchLength(), static_cast<size_t>(end - pos));
+        auto const length = maxLength > 0 ? 1 + matchLength(pos + 1, pos, maxLength - 1) : 0;
+        bool matchFound{false};
+        if (length > 1)
+        {
+            for (unsigned int cls = 0; cls < matchClassCount(); ++cls)
+            {
+                auto const& matchCls = matchClass(cls);
+                if (length >= matchCls.length.min)
+                {
+                    this->m_matches[cls].cls = cls;
+                    this->m_matches[cls].length = std::min(length, matchCls.length.max);
+                    matchFound = true;
+                }
+            }
+        }
+        return matchFound;
+    }
+
+    template <class Iterator> void advance(Iterator, Iterator, Iterator, size_t)
+    {
+    }
+
+    void rebase(const size_t)
+    {
+    }
+
+    void reset()
+    {
+    }
+};
+
+enum class ParseStrategy
+{
+    // take the best match at every position
+    Greedy,
+    // like greedy, but emit a literal instead if one of the next positions has a better match
+    Lazy,
+    // minimize the encoded size of each block using the prices of the match classes
+    Optimal,
+};
+
+struct ParseOptions
+{
+    ParseStrategy strategy{ParseStrategy::Greedy};
+
+    // Lazy: number of following positions checked for a better match
+    size_t lazyDepth{1};
+
+    // Optimal: encoded size of a literal in bits
+    size_t literalCost{8};
+    // Optimal: encoded size in bits of the headers of a run of the given number of literals, on top
+    // of their literalCost; must not decrease with the length. None if null.
+    size_t (*literalRunCost)(size_t length){nullptr};
+    // Optimal: number of positions parsed at once; bounds memory usage
+    size_t blockLength{1 << 16};
+    // Optimal: number of match lengths tried per match class, starting from the longest; bounds
+    // the time spent per position
+    size_t lengthsPerClass{32};
+
+    // Number of threads searching matches ahead of the parse; 0 uses all cores. With more than
+    // one, every thread searches its own chunk of the input with a copy of the matchers that is
+    // first advanced over the window before the chunk. The matches only equal those of a single
+    // thread if they only depend on the window contents, as with HashChainMatcher and
+    // SuffixArrayMatcher. Insertion policies are not applied.
+    unsigned int threads{1};
+    // Threads: number of positions searched by one thread at a time
+    size_t chunkLength{1 << 18};
+
+    // compressParallel(): number of positions compressed by one thread at a time
+    size_t parallelBlockLength{1 << 20};
+};
+
+// Processor that records the tokens of a parse, to be replayed into another processor later.
+// Consecutive literals are kept as one token.
+template <class... Matches> class TokenRecorder
+{
+public:
+    void consumeLiteral(const uint8_t* pos)
+    {
+        if (m_tokens.empty() || m_tokens.back().match.index() != 0 || m_tokens.back().end != pos)
+        {
+            m_tokens.push_back(Token{pos, pos, {}});
+        }
+        ++m_tokens.back().end;
+    }
+
+    template <class Match>
+    void consumeMatch(const uint8_t* begin, const uint8_t* end, const Match& match)
+    {
+        m_tokens.push_back(Token{begin, end, {}});
+        m_tokens.back().match.template emplace<indexOf<Match>()>(match);
+    }
+
+    template <class Processor> void replay(Processor& processor) const
+    {
+        for (auto const& token : m_tokens)
+        {
+            if (token.match.index() == 0)
+            {
+                for (auto const* pos = token.begin; pos < token.end; ++pos)
+                {
+                    processor.consumeLiteral(pos);
+                }
+                continue;
+            }
+
+            std::visit(
+                [&](auto const& match) {
+                    if constexpr (!std::is_same_v<std::decay_t<decltype(match)>, std::monostate>)
+                    {
+                        processor.consumeMatch(token.begin, token.end, match);
+                    }
+                },
+                token.match);
+        }
+    }
+
+private:
+    struct Token
+    {
+        const uint8_t* begin;
+        const uint8_t* end;
+        // literals: std::monostate
+        std::variant<std::monostate, Matches...> match;
+    };
+
+    // Index of the first alternative of type Match; several matchers may share a match type.
+    template <class Match> static constexpr auto indexOf() -> size_t
+    {
+        size_t index{1};
+        ((std::is_same_v<Match, Matches> ? false : (++index, true)) && ...);
+        return index;
+    }
+
+    std::vector<Token> m_tokens;
+};
+
+template <class... Matchers> class LzCompressor
+{
+public:
+    LzCompressor() = default;
+
+    explicit LzCompressor(Matchers&&... matchers)
+        : m_matchers{std::forward<Matchers>(matchers)...}
+    {
+    }
+
+    explicit LzCompressor(const ParseOptions& options, Matchers&&... matchers)
+        : m_options{options}
+        , m_matchers{std::forward<Matchers>(matchers)...}
+    {
+    }
+
+    auto parseOptions() const -> const ParseOptions&
+    {
+        return m_options;
+    }
+
+    void setParseOptions(const ParseOptions& options)
+    {
+        m_options = options;
+    }
+
+    template<class Matcher = std::tuple_element_t<0, std::tuple<Matchers...>>>
+    auto matcher() const -> const Matcher&
+    {
+        return std::get<Matcher>(m_matchers);
+    }
+
+    template<class Matcher = std::tuple_element_t<0, std::tuple<Matchers...>>>
+    auto matcher() -> Matcher&
+    {
+        return std::get<Matcher>(m_matchers);
+    }
+
+    template<size_t I> void advanceMatchers(const uint8_t* begin, const uint8_t* end, const uint8_t* pos, size_t steps)
+    {
+        advanceMatchers<I>(m_matchers, begin, end, pos, steps);
+    }
+
+    template <class Processor>
+    void compress(const uint8_t* data, const size_t size, Processor& processor,
+                  size_t startOffset = 0)
+    {
+        auto const* begin = data;
+        auto const* pos = data;
+        auto const* end = data + size;
+
+        m_threads = m_options.threads != 0 ? m_options.threads
+                                           : std::max(std::thread::hardware_concurrency(), 1u);
+        m_searched.clear();
+        m_searchedFrom = startOffset;
+        if (m_threads > 1)
+        {
+            prepareMatchers<0>(m_matchers, begin, end);
+        }
+        else
+        {
+            advanceParsedMatchers<0>(begin, end, pos, startOffset);
+        }
+
+        parse(begin, pos + startOffset, end, end, processor);
+    }
+
+    // Like compress() with a startOffset, but the bytes before the data are a separate prefix, e.g.
+    // a fixed dictionary: matches may refer to its last window, but it is not compressed. Only the
+    // window of prefix and the first window of data are copied to a buffer; once the matchers no
+    // longer refer to the prefix, they are rebased onto the data, which is parsed in place. If the
+    // prefix is no longer than the longest window, the tokens are those of compress() on the prefix
+    // and data put together; of a longer prefix, only that window is advanced over, so the matchers
+    // may find other matches than compress() would. Matches are searched on the calling thread.
+    // All matchers must support rebase().
+    // The same prefix may have been passed to primePrefix() before.
+    template <class Processor>
+    void compressWithPrefix(const uint8_t* prefix, const size_t prefixSize, const uint8_t* data,
+                            const size_t size, Processor& processor)
+    {
+        m_threads = 1;
+        auto const history = streamHistory<0>();
+        auto const kept = std::min(prefixSize, history);
+        auto headLength = history;
+        if (m_options.strategy == ParseStrategy::Optimal)
+        {
+            // whole blocks only, as in streaming
+            auto const blockLength = std::max(m_options.blockLength, size_t{1});
+            headLength += (blockLength - headLength % blockLength) % blockLength;
+        }
+        auto const lookAhead = 2 * streamLookAhead<0>() + m_options.lazyDepth;
+
+        auto& head = m_head;
+        head.resize(kept + std::min(size, headLength + lookAhead));
+        // copy_n, as the prefix or data may be null when empty
+        std::copy_n(prefix + prefixSize - kept, kept, head.data());
+        std::copy_n(data, head.size() - kept, head.data() + kept);
+        auto const* begin = head.data();
+        auto const* end = begin + head.size();
+        advanceMatchers<0>(m_matchers, begin, end, begin + m_primedPrefix, kept - m_primedPrefix);
+        m_primedPrefix = 0;
+        if (head.size() - kept == size)
+        {
+            parse(begin, begin + kept, end, end, processor);
+            return;
+        }
+
+        auto const* pos = parse(begin, begin + kept, begin + kept + headLength, end, processor);
+        detachInput(processor);
+        rebaseMatchers<0>(kept);
+        parse(data, data + (pos - begin - kept), data + size, data + size, processor);
+    }
+
+    // Advances the matchers over the prefix of compressWithPrefix() as far as its strings do not
+    // reach into the data, leaving out the last longest match length of bytes. Matchers are
+    // values, so a copy of the compressor taken now is a snapshot of the primed state: every copy
+    // can compress different data after the same prefix, without priming again.
+    void primePrefix(const uint8_t* prefix, const size_t prefixSize)
+    {
+        auto const kept = std::min(prefixSize, streamHistory<0>());
+        auto const lookAhead = streamLookAhead<0>();
+        auto const* begin = prefix + prefixSize - kept;
+        m_primedPrefix = kept > lookAhead ? kept - lookAhead : 0;
+        advanceMatchers<0>(m_matchers, begin, prefix + prefixSize, begin, m_primedPrefix);
+    }
+
+    // Like compress(), but compresses blocks of ParseOptions::parallelBlockLength positions on
+    // ParseOptions::threads threads and replays their tokens into the processor in order. Every
+    // block is compressed with its own copy of the matchers, advanced over the window before the
+    // block. Matches do not cross block boundaries, which costs a little ratio; otherwise the
+    // processor sees a regular parse of the whole input.
+    template <class Processor>
+    void compressParallel(const uint8_t* data, const size_t size, Processor& processor,
+                          size_t startOffset = 0)
+    {
+        auto const threads = m_options.threads != 0
+                                 ? m_options.threads
+                                 : std::max(std::thread::hardware_concurrency(), 1u);
+        auto const blockLength = std::max(m_options.parallelBlockLength, size_t{1});
+        for (auto round = startOffset; round < size; round += blockLength * threads)
+        {
+            auto const roundEnd = std::min(size, round + blockLength * threads);
+            std::vector<std::future<TokenRecorder<typename Matchers::Match...>>> blocks;
+            for (auto from = round; from < roundEnd; from += blockLength)
+            {
+                auto const to = std::min(from + blockLength, roundEnd);
+                blocks.push_back(std::async(std::launch::async, [=, this] {
+                    return compressBlock(data, from, to);
+                }));
+            }
+            for (auto& block : blocks)
+            {
+                block.get().replay(processor);
+            }
+        }
+    }
+
+    // Streaming: instead of passing all of the input to compress(), it can be fed in chunks of any
+    // size. Only the windows of the matchers, the look-ahead of the parse and the unparsed input
+    // are kept in a buffer; when it slides, the matchers are rebased. The pointers passed to the
+    // processor are only valid until the buffer slides or grows; before it does, detachInput() is
+    // called on a processor that has it, to copy the bytes it still needs.
+    // Matches are searched on the calling thread. All matchers must support rebase() and reset().
+
+    // Adds bytes that precede the stream, like the startOffset of compress(): matches may refer to
+    // them, but they are not compressed. Only before the first feed().
+    void prime(const uint8_t* data, const size_t size)
+    {
+        m_stream.insert(m_stream.end(), data, data + size);
+        advanceMatchers<0>(m_matchers, m_stream.data(), m_stream.data() + m_stream.size(),
+                           m_stream.data() + m_streamPos, size);
+        m_streamPos += size;
+    }
+
+    // Compresses as much of the input fed so far as can be without knowing what follows.
+    template <class Processor>
+    void feed(const uint8_t* data, const size_t size, Processor& processor)
+    {
+        if (m_stream.size() + size > m_stream.capacity())
+        {
+            detachInput(processor);
+        }
+        m_stream.insert(m_stream.end(), data, data + size);
+        parseStream(processor, false);
+    }
+
+    // Compresses all of the input fed so far. Matches do not cross the flushed position, and the
+    // strings right before it are found less well, so flush only when needed.
+    template <class Processor> void flush(Processor& processor)
+    {
+        parseStream(processor, true);
+    }
+
+    // Flushes the stream and empties the matchers, so that the next feed() or prime() starts a
+    // new stream. The buffer keeps its memory.
+    template <class Processor> void finish(Processor& processor)
+    {
+        flush(processor);
+        m_stream.clear();
+        m_streamPos = 0;
+        resetMatchers<0>();
+    }
+
+    // Parses the positions from pos up to stop; matches may go on up to end. Returns the position
+    // after the last token.
+    template <class Processor>
+    auto parse(const uint8_t* begin, const uint8_t* pos, const uint8_t* stop, const uint8_t* end,
+               Processor& processor) -> const uint8_t*
+    {
+        switch (m_options.strategy)
+        {
+        case ParseStrategy::Greedy: return parseGreedy(begin, pos, stop, end, processor);
+        case ParseStrategy::Lazy: return parseLazy(begin, pos, stop, end, processor);
+        case ParseStrategy::Optimal: return parseOptimal(begin, pos, stop, end, processor);
+        }
+        return pos;
+    }
+
+    template <class Processor>
+    auto parseGreedy(const uint8_t* begin, const uint8_t* pos, const uint8_t* stop,
+                     const uint8_t* end, Processor& processor) -> const uint8_t*
+    {
+        while (pos < stop)
+        {
+            std::tuple<typename Matchers::Match...> matches;
+            if (findMatches<0>(matches, begin, pos, end))
+            {
+                auto const new_pos = applyMatch<0>(matches, processor, begin, pos, end);                
+                advanceMatchersOverMatch<0>(begin, end, pos, new_pos - pos);
+                pos = new_pos;
+            }
+            else
+            {
+                processor.consumeLiteral(pos);
+                advanceParsedMatchers<0>(begin, end, pos, 1);
+                pos += 1;
+            }
+        }
+        return pos;
+    }
+
+    template <class Processor>
+    auto parseLazy(const uint8_t* begin, const uint8_t* pos, const uint8_t* stop,
+                   const uint8_t* end, Processor& processor) -> const uint8_t*
+    {
+        if (pos >= stop)
+        {
+            return pos;
+        }
+
+        std::tuple<typename Matchers::Match...> matches;
+        auto quality = findMatches<0>(matches, begin, pos, end);
+        // a deferred match is taken even beyond stop, since its position was searched already
+        bool deferred{false};
+        while (pos < stop || deferred)
+        {
+            deferred = false;
+            if (!quality)
+            {
+                processor.consumeLiteral(pos);
+                advanceParsedMatchers<0>(begin, end, pos, 1);
+                pos += 1;
+            }
+            else
+            {
+                // Before committing to the match, check whether waiting a position or two pays
+                // off. Every further deferred position raises the bar, since it costs a literal.
+                auto const length = matchLength<0>(matches);
+                size_t ahead{0};
+                while (ahead < m_options.lazyDepth && ahead + 1 < length)
+                {
+                    advanceParsedMatchers<0>(begin, end, pos + ahead, 1);
+                    ahead += 1;
+
+                    std::tuple<typename Matchers::Match...> next;
+                    auto const nextQuality = findMatches<0>(next, begin, pos + ahead, end);
+                    if (nextQuality && *nextQuality > *quality + 2 * (ahead - 1))
+                    {
+                        for (size_t i = 0; i < ahead; ++i)
+                        {
+                            processor.consumeLiteral(pos + i);
+                        }
+                        pos += ahead;
+                        matches = next;
+                        quality = nextQuality;
+                        deferred = true;
+                        break;
+                    }
+                }
+                if (deferred)
+                {
+                    continue;
+                }
+
+                auto const new_pos = applyMatch<0>(matches, processor, begin, pos, end);
+                advanceMatchersOverMatch<0>(begin, end, pos + ahead, (new_pos - pos) - ahead);
+                pos = new_pos;
+            }
+
+            if (pos < stop)
+            {
+                matches = {};
+                quality = findMatches<0>(matches, begin, pos, end);
+            }
+        }
+        return pos;
+    }
+
+    template<size_t I>
+    auto findMatches(std::tuple<typename Matchers::Match...>& matches,
+        const uint8_t* begin, const uint8_t* pos, const uint8_t* end) -> std::optional<size_t>
+    {
+        std::optional<size_t> best;
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            best = findMatches<I+1>(matches, begin, pos, end);
+        }
+
+        auto const& matcher = std::get<I>(m_matchers);
+        auto& match = std::get<I>(matches);
+        auto const& found = searchMatches<I>(begin, pos, end);
+        if (std::any_of(found.begin(), found.end(), [](auto const& m) { return m.isValid(); }))
+        {
+            auto const bestClass = matcher.bestMatch(found);
+            auto const& bestMatch = found[bestClass];
+            auto const quality = matcher.matchClass(bestClass).quality(bestMatch);
+            if (!best || quality > *best)
+            {
+                match = bestMatch;
+                return quality;
+            }
+        }
+        return best;
+    }
+
+    template<size_t I, class Processor>
+    auto applyMatch(std::tuple<typename Matchers::Match...>& matches,
+        Processor& processor,
+        const uint8_t* begin, const uint8_t* pos, const uint8_t* end) -> const uint8_t*
+    {
+        auto const& match = std::get<I>(matches);
+        if (match.isValid())
+        {
+            processor.consumeMatch(pos, pos + match.length, match);
+            return pos + match.length;
+        }
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            return applyMatch<I + 1>(matches, processor, begin, pos, end);
+        }
+        else
+        {
+            throw std::runtime_error{"no match - should not happen"};
+        }
+    }
+
+    template <size_t I>
+    auto matchLength(const std::tuple<typename Matchers::Match...>& matches) const -> size_t
+    {
+        auto const& match = std::get<I>(matches);
+        if (match.isValid())
+        {
+            return match.length;
+        }
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            return matchLength<I + 1>(matches);
+        }
+        else
+        {
+            return 0;
+        }
+    }
+
+    template <class Processor>
+    auto parseOptimal(const uint8_t* begin, const uint8_t* pos, const uint8_t* stop,
+                      const uint8_t* end, Processor& processor) -> const uint8_t*
+    {
+        while (pos < stop)
+        {
+            auto const blockLength = std::max(m_options.blockLength, size_t{1});
+            auto const length = std::min(static_cast<size_t>(stop - pos), blockLength);
+
+            // The matchers only depend on the positions inserted so far, so all candidates of the
+            // block can be collected up front.
+            m_candidates.resize(length);
+            for (size_t i = 0; i < length; ++i)
+            {
+                if (m_threads > 1)
+                {
+                    m_candidates[i] = searched(begin, pos + i, end);
                 }
                 else
                 {
-                    setRight(i, m_positionBase);
-                    return;
+                    collectMatches<0>(m_matchers, m_candidates[i], begin, pos + i, end);
+                    advanceParsedMatchers<0>(begin, end, pos + i, 1);
                 }
             }
-            else
+
+            // Shortest path over the block: m_steps[i] is the cheapest way to reach position i with
+            // a match, m_literalSteps[i] with a literal, ending a run of literals whose headers
+            // price the next literal. Matches leave from the cheaper of both, literals from both,
+            // as a longer run may turn out cheaper than a new one after a match.
+            m_steps.assign(length + 1, Step{});
+            m_literalSteps.assign(length + 1, Step{});
+            m_steps[0].price = 0;
+            for (size_t i = 0; i < length; ++i)
             {
-                if (m_nodes[i].hasLeft())
+                relaxLiteral(i, m_steps[i], false);
+                relaxLiteral(i, m_literalSteps[i], true);
+                relaxMatches<0>(i, length);
+            }
+
+            m_path.clear();
+            auto literal = m_literalSteps[length].price < m_steps[length].price;
+            for (size_t i = length; i > 0;)
+            {
+                m_path.emplace_back(i, literal);
+                auto const& step = literal ? m_literalSteps[i] : m_steps[i];
+                i -= step.length;
+                literal = step.fromLiteral;
+            }
+            for (auto it = m_path.rbegin(); it != m_path.rend(); ++it)
+            {
+                auto const [to, isLiteral] = *it;
+                auto const& step = isLiteral ? m_literalSteps[to] : m_steps[to];
+                auto const from = to - step.length;
+                if (isLiteral)
                 {
-                    i = m_nodes[i].left;
+                    processor.consumeLiteral(pos + from);
                 }
                 else
                 {
-                    setLeft(i, m_positionBase);
-                    return;
+                    applyCandidate<0>(processor, pos, from, step);
                 }
             }
+
+            pos += length;
         }
+        return pos;
     }
 
-    auto inorderPredecessor(const unsigned int n) const -> unsigned int
+private:
+    // Advances the matchers while parsing; with search threads, they are advanced by the threads.
+    template <size_t I>
+    void advanceParsedMatchers(const uint8_t* begin, const uint8_t* end, const uint8_t* pos,
+                               const size_t steps)
     {
-        auto min = n;
-        while (true)
+        if (m_threads <= 1)
         {
-            if (m_nodes[min].left == EmptyNode)
-            {
-                return min;
-            }
-            else
-            {
-                min = m_nodes[min].left;
-            }
+            advanceMatchers<I>(m_matchers, begin, end, pos, steps);
         }
     }
 
-    void remove(const unsigned int n)
+    // Advances the matchers over the positions covered by a match. Matchers that support it may
+    // leave some of these positions out (see InsertionPolicy).
+    template <size_t I>
+    void advanceMatchersOverMatch(const uint8_t* begin, const uint8_t* end, const uint8_t* pos,
+                                  size_t steps)
     {
-        auto const toDelete = n;
-        unsigned int replacement;
-        if (!m_nodes[toDelete].hasLeft())
+        if (m_threads > 1)
         {
-            replacement = m_nodes[toDelete].right;
+            return;
         }
-        else if (!m_nodes[toDelete].hasRight())
+
+        auto& matcher = std::get<I>(m_matchers);
+        if constexpr (requires { matcher.advanceMatch(begin, end, pos, steps); })
         {
-            replacement = m_nodes[toDelete].left;
+            matcher.advanceMatch(begin, end, pos, steps);
         }
         else
         {
-            replacement = inorderPredecessor(m_nodes[toDelete].right);
-            setLeft(replacement, m_nodes[toDelete].left);
-            if (replacement != m_nodes[toDelete].right)
-            {
-                setLeft(m_nodes[replacement].parent, m_nodes[replacement].right);
-                setRight(replacement, m_nodes[toDelete].right);
-            }
+            matcher.advance(begin, end, pos, steps);
+        }
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            advanceMatchersOverMatch<I + 1>(begin, end, pos, steps);
         }
-        replace(toDelete, replacement);
-        m_nodes[toDelete].clear();
     }
 
-    void setLeft(const unsigned int n, const unsigned int left)
+    using Candidates = std::tuple<typename Matchers::Matches...>;
+
+    static constexpr unsigned int LiteralStep = ~static_cast<unsigned int>(0);
+    // minimum number of bytes the stream buffer slides by
+    static constexpr size_t StreamSlideLength = size_t{1} << 16;
+
+    struct Step
     {
-        m_nodes[n].left = left;
-        if (left != EmptyNode)
+        size_t price{std::numeric_limits<size_t>::max()};
+        size_t length{0};
+        unsigned int matcher{LiteralStep};
+        unsigned int cls{0};
+        // number of literals the path ends with
+        size_t run{0};
+        // whether the step leaves from the literal state of its start
+        bool fromLiteral{false};
+    };
+
+    template <size_t I>
+    void collectMatches(std::tuple<Matchers...>& matchers, Candidates& candidates,
+                        const uint8_t* begin, const uint8_t* pos, const uint8_t* end)
+    {
+        auto& matcher = std::get<I>(matchers);
+        matcher.findMatches(begin, end, pos);
+        std::get<I>(candidates) = matcher.matches();
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
         {
-            m_nodes[left].parent = n;
+            collectMatches<I + 1>(matchers, candidates, begin, pos, end);
         }
     }
 
-    void setRight(const unsigned int n, const unsigned int right)
+    template <size_t I>
+    static void advanceMatchers(std::tuple<Matchers...>& matchers, const uint8_t* begin,
+                                const uint8_t* end, const uint8_t* pos, const size_t steps)
     {
-        m_nodes[n].right = right;
-        if (right != EmptyNode)
+        std::get<I>(matchers).advance(begin, end, pos, steps);
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
         {
-            m_nodes[right].parent = n;
+            advanceMatchers<I + 1>(matchers, begin, end, pos, steps);
         }
     }
 
-    void replace(const unsigned int n, const unsigned int replacement)
+    // The matches of matcher I at pos, searched now or by the threads.
+    template <size_t I>
+    auto searchMatches(const uint8_t* begin, const uint8_t* pos, const uint8_t* end)
+        -> const std::tuple_element_t<I, Candidates>&
     {
-        if (n != m_root)
-        {
-            if (m_nodes[m_nodes[n].parent].left == n)
-            {
-                setLeft(m_nodes[n].parent, replacement);
-            }
-            else
-            {
-                setRight(m_nodes[n].parent, replacement);
-            }
-        }
-        else
+        if (m_threads > 1)
         {
-            m_root = replacement;
-            m_nodes[replacement].parent = EmptyNode;
+            return std::get<I>(searched(begin, pos, end));
         }
-    }
 
-    auto windowLength() const -> size_t
-    {
-        return m_nodes.size();
+        auto& matcher = std::get<I>(m_matchers);
+        matcher.findMatches(begin, end, pos);
+        return matcher.matches();
     }
 
-    auto nodeIndexToOffset(const unsigned int i) const -> size_t
+    // The matches at pos, searched by the threads. Positions must be asked for in ascending
+    // order; once a position beyond the searched ones is asked for, the next chunks are searched
+    // from there, as a match may have jumped past all of them.
+    auto searched(const uint8_t* begin, const uint8_t* pos, const uint8_t* end) -> const Candidates&
     {
-        return ((m_positionBase - i - 1) % windowLength()) + 1;
-        // auto const offset =
-        // m_positionPos > i ? (m_positionBase - i) : (windowLength() + (m_positionBase - i));
+        auto const position = static_cast<size_t>(pos - begin);
+        if (position >= m_searchedFrom + m_searched.size())
+        {
+            searchAhead(begin, position, end);
+        }
+        return m_searched[position - m_searchedFrom];
     }
 
-    struct Node
+    void searchAhead(const uint8_t* begin, const size_t from, const uint8_t* end)
     {
-        unsigned int left{0}, right{0};
-        unsigned int parent{0};
-
-        void clear()
+        auto const chunkLength = std::max(m_options.chunkLength, size_t{1});
+        auto const length =
+            std::min(static_cast<size_t>(end - begin) - from, chunkLength * m_threads);
+        m_searched.resize(length);
+        m_searchedFrom = from;
+
+        std::vector<std::future<void>> chunks;
+        for (size_t chunk = 0; chunk < length; chunk += chunkLength)
         {
-            left = right = parent = EmptyNode;
+            chunks.push_back(std::async(std::launch::async, [=, this] {
+                searchChunk(begin, begin + from + chunk,
+                            begin + from + std::min(chunk + chunkLength, length), end);
+            }));
         }
-
-        bool hasLeft() const
+        for (auto& chunk : chunks)
         {
-            return left != EmptyNode;
+            chunk.get();
         }
+    }
 
-        bool hasRight() const
+    void searchChunk(const uint8_t* begin, const uint8_t* from, const uint8_t* to,
+                     const uint8_t* end)
+    {
+        auto matchers = m_matchers;
+        primeMatchers<0>(matchers, begin, from, end);
+        for (auto const* pos = from; pos < to; ++pos)
         {
-            return right != EmptyNode;
+            collectMatches<0>(matchers, m_searched[pos - begin - m_searchedFrom], begin, pos, end);
+            advanceMatchers<0>(matchers, begin, end, pos, 1);
         }
-    };
-
-    std::vector<Node> m_nodes;
-    unsigned int m_root{EmptyNode};
-    size_t m_positionBase{0};
-};
-
-struct RleMatch
-{
-    size_t cls;
-    size_t length;
-
-    bool isValid() const
-    {
-        return length != 0;
     }
 
-    void reset()
+    // Advances fresh matchers over the window before from; matchers that do not tell their window
+    // length are advanced from the start.
+    template <size_t I>
+    static void primeMatchers(std::tuple<Matchers...>& matchers, const uint8_t* begin,
+                              const uint8_t* from, const uint8_t* end)
     {
-        length = 0;
+        auto& matcher = std::get<I>(matchers);
+        auto start = begin;
+        if constexpr (requires { matcher.windowLength(); })
+        {
+            start = from - std::min(static_cast<size_t>(from - begin), matcher.windowLength());
+        }
+        matcher.advance(begin, end, start, static_cast<size_t>(from - start));
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            primeMatchers<I + 1>(matchers, begin, from, end);
+        }
     }
-};
-
-struct RleMatchClass
-{
-    using Match = RleMatch;
-
-    size_t overhead{0};
-    Range length;
 
-    auto quality(const Match& match) const -> size_t
+    auto compressBlock(const uint8_t* data, const size_t from, const size_t to) const
+        -> TokenRecorder<typename Matchers::Match...>
     {
-        return match.length - overhead;
-    }
-};
+        auto lz = *this;
+        lz.m_options.threads = 1;
 
-template <unsigned int MatchClasses>
-class RleMatcher : public StringMatcher<RleMatchClass, MatchClasses>
-{
-public:
-    using StringMatcher<RleMatchClass, MatchClasses>::maxMatchLength;
-    using StringMatcher<RleMatchClass, MatchClasses>::matchClass;
-    using StringMatcher<RleMatchClass, MatchClasses>::matchClassCount;
-    using StringMatcher<RleMatchClass, MatchClasses>::resetMatches;
+        auto const lookBack = primeLength<0>(from);
+        TokenRecorder<typename Matchers::Match...> recorder;
+        lz.compress(data + from - lookBack, to - from + lookBack, recorder, lookBack);
+        return recorder;
+    }
 
-    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    // Number of positions before from that the matchers need to see: the longest window, or all
+    // positions if a matcher does not tell its window length.
+    template <size_t I> auto primeLength(const size_t from) const -> size_t
     {
-        resetMatches();
-
-        auto rlePos = pos;
-        auto const value = *pos;
-        while (rlePos < end && *rlePos == value && rlePos - pos < maxMatchLength())
+        auto const& matcher = std::get<I>(m_matchers);
+        size_t length{from};
+        if constexpr (requires { matcher.windowLength(); })
+        {
+            length = std::min(from, matcher.windowLength());
+        }
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
         {
-            ++rlePos;
+            length = std::max(length, primeLength<I + 1>(from));
         }
+        return length;
+    }
 
-        auto const length = static_cast<size_t>(rlePos - pos);
-        bool matchFound{false};
-        if (length > 1)
+    template <class Processor> void parseStream(Processor& processor, const bool flushing)
+    {
+        m_threads = 1;
+        auto const* begin = m_stream.data();
+        auto const* end = begin + m_stream.size();
+        auto const* pos = begin + m_streamPos;
+
+        // Every parsed position needs its longest match in the buffer, and so does every position
+        // the matchers are advanced over; with lazy parsing, also the deferred ones.
+        auto stop = end;
+        if (!flushing)
         {
-            for (unsigned int cls = 0; cls < matchClassCount(); ++cls)
+            auto const lookAhead = 2 * streamLookAhead<0>() + m_options.lazyDepth;
+            auto available = static_cast<size_t>(end - pos);
+            available = available > lookAhead ? available - lookAhead : 0;
+            if (m_options.strategy == ParseStrategy::Optimal)
             {
-                auto const& matchCls = matchClass(cls);
-                if (length >= matchCls.length.min)
-                {
-                    this->m_matches[cls].cls = cls;
-                    this->m_matches[cls].length = std::min(length, matchCls.length.max);
-                    matchFound = true;
-                }
+                // whole blocks only, so that the parse does not depend on the chunks fed
+                auto const blockLength = std::max(m_options.blockLength, size_t{1});
+                available -= available % blockLength;
             }
+            stop = pos + available;
+        }
+
+        pos = parse(begin, pos, stop, end, processor);
+        m_streamPos = static_cast<size_t>(pos - begin);
+
+        // Drop what is neither in a window nor parsed yet. Sliding copies the rest of the buffer,
+        // so only slide by at least a window length.
+        auto const history = streamHistory<0>();
+        if (m_streamPos >= history + std::max(history, StreamSlideLength))
+        {
+            detachInput(processor);
+            auto const distance = m_streamPos - history;
+            m_stream.erase(m_stream.begin(), m_stream.begin() + distance);
+            m_streamPos -= distance;
+            rebaseMatchers<0>(distance);
         }
-        return matchFound;
     }
 
-    template <class Iterator> void advance(Iterator, Iterator, Iterator, size_t)
+    template <size_t I> auto streamLookAhead() const -> size_t
     {
+        auto length = std::get<I>(m_matchers).maxMatchLength();
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            length = std::max(length, streamLookAhead<I + 1>());
+        }
+        return length;
     }
-};
-
-template <class... Matchers> class LzCompressor
-{
-public:
-    LzCompressor() = default;
 
-    explicit LzCompressor(Matchers&&... matchers)
-        : m_matchers{std::forward<Matchers>(matchers)...}
+    template <size_t I> auto streamHistory() const -> size_t
     {
+        auto length = std::get<I>(m_matchers).windowLength();
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            length = std::max(length, streamHistory<I + 1>());
+        }
+        return length;
     }
 
-    template<class Matcher = std::tuple_element_t<0, std::tuple<Matchers...>>>
-    auto matcher() const -> const Matcher&
+    template <size_t I> void rebaseMatchers(const size_t distance)
     {
-        return std::get<Matcher>(m_matchers);
+        auto& matcher = std::get<I>(m_matchers);
+        static_assert(requires { matcher.rebase(distance); },
+                      "LzCompressor: streaming requires matchers that support rebase()");
+        matcher.rebase(distance);
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            rebaseMatchers<I + 1>(distance);
+        }
     }
 
-    template<class Matcher = std::tuple_element_t<0, std::tuple<Matchers...>>>
-    auto matcher() -> Matcher&
+    // Tells the processor that the input moves, so that pointers into it it still holds break
+    // off from those it gets next. Processors without detachInput() do not keep pointers.
+    template <class Processor> static void detachInput(Processor& processor)
     {
-        return std::get<Matcher>(m_matchers);
+        if constexpr (requires { processor.detachInput(); })
+        {
+            processor.detachInput();
+        }
     }
 
-    template<size_t I> void advanceMatchers(const uint8_t* begin, const uint8_t* end, const uint8_t* pos, size_t steps)
+    template <size_t I> void resetMatchers()
     {
-        std::get<I>(m_matchers).advance(begin, end, pos, steps);
+        auto& matcher = std::get<I>(m_matchers);
+        static_assert(requires { matcher.reset(); },
+                      "LzCompressor: streaming requires matchers that support reset()");
+        matcher.reset();
         if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
         {
-            advanceMatchers<I+1>(begin, end, pos, steps);
+            resetMatchers<I + 1>();
         }
     }
 
-    template <class Processor>
-    void compress(const uint8_t* data, const size_t size, Processor& processor,
-                  size_t startOffset = 0)
+    // Lets matchers set up state that their copies share.
+    template <size_t I>
+    static void prepareMatchers(std::tuple<Matchers...>& matchers, const uint8_t* begin,
+                                const uint8_t* end)
     {
-        auto const* begin = data;
-        auto const* pos = data;
-        auto const* end = data + size;
-
-        advanceMatchers<0>(begin, end, pos, startOffset);
+        auto& matcher = std::get<I>(matchers);
+        if constexpr (requires { matcher.prepare(begin, end); })
+        {
+            matcher.prepare(begin, end);
+        }
+        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            prepareMatchers<I + 1>(matchers, begin, end);
+        }
+    }
 
-        pos += startOffset;
-        while (pos < end)
+    void relax(const size_t from, const size_t length, const size_t price,
+               const unsigned int matcher, const unsigned int cls)
+    {
+        auto& step = m_steps[from + length];
+        if (price < step.price)
         {
-            std::tuple<typename Matchers::Match...> matches;
-            if (findMatches<0>(matches, begin, pos, end))
-            {
-                auto const new_pos = applyMatch<0>(matches, processor, begin, pos, end);                
-                advanceMatchers<0>(begin, end, pos, new_pos - pos);
-                pos = new_pos;
-            }
-            else
-            {
-                processor.consumeLiteral(pos);
-                advanceMatchers<0>(begin, end, pos, 1);
-                pos += 1;
-            }
+            auto const fromLiteral = m_literalSteps[from].price < m_steps[from].price;
+            step = Step{price, length, matcher, cls, 0, fromLiteral};
         }
     }
 
-    template<size_t I>
-    auto findMatches(std::tuple<typename Matchers::Match...>& matches,
-        const uint8_t* begin, const uint8_t* pos, const uint8_t* end) -> std::optional<size_t>
+    // Extends the run of literals that the state at from ends with by one.
+    void relaxLiteral(const size_t from, const Step& state, const bool fromLiteral)
     {
-        std::optional<size_t> best;
-        if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        if (state.price == std::numeric_limits<size_t>::max())
         {
-            best = findMatches<I+1>(matches, begin, pos, end);
+            return;
+        }
+        auto const price = state.price + literalPrice(state.run);
+        auto& step = m_literalSteps[from + 1];
+        if (price < step.price)
+        {
+            step = Step{price, 1, LiteralStep, 0, state.run + 1, fromLiteral};
         }
+    }
 
-        auto& matcher = std::get<I>(m_matchers);
-        auto& match = std::get<I>(matches);
-        const bool found = matcher.findMatches(begin, end, pos);
-        if (found)
+    // The price of a literal after a run of run literals, including what it adds to their headers.
+    auto literalPrice(const size_t run) const -> size_t
+    {
+        auto price = m_options.literalCost;
+        if (m_options.literalRunCost)
         {
-            auto const bestClass = matcher.bestMatch();
-            auto const& bestMatch = matcher.match(bestClass);
-            auto const quality = matcher.matchClass(bestClass).quality(bestMatch);
-            if (!best || quality > *best)
-            {
-                match = bestMatch;
-                return quality;
-            }
+            price += m_options.literalRunCost(run + 1) - m_options.literalRunCost(run);
         }
-        return best;
+        return price;
     }
 
-    template<size_t I, class Processor>
-    auto applyMatch(std::tuple<typename Matchers::Match...>& matches,
-        Processor& processor,
-        const uint8_t* begin, const uint8_t* pos, const uint8_t* end) -> const uint8_t*
+    template <size_t I> void relaxMatches(const size_t from, const size_t blockLength)
     {
-        auto const& match = std::get<I>(matches);
-        if (match.isValid())
+        auto const& matcher = std::get<I>(m_matchers);
+        auto const& matches = std::get<I>(m_candidates[from]);
+        auto const price = std::min(m_steps[from].price, m_literalSteps[from].price);
+        for (unsigned int cls = 0; cls < matches.size(); ++cls)
         {
-            processor.consumeMatch(pos, pos + match.length, match);
-            return pos + match.length;
+            if (!matches[cls].isValid())
+            {
+                continue;
+            }
+
+            auto const& matchCls = matcher.matchClass(cls);
+            auto trial = matches[cls];
+            auto const longest = std::min(trial.length, blockLength - from);
+            for (size_t length = longest, tried = 0;
+                 length >= matchCls.length.min && length > 1 && tried < m_options.lengthsPerClass;
+                 --length, ++tried)
+            {
+                trial.length = length;
+                relax(from, length, price + matchCls.price(trial), I, cls);
+            }
         }
         if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
         {
-            return applyMatch<I + 1>(matches, processor, begin, pos, end);
+            relaxMatches<I + 1>(from, blockLength);
         }
-        else
+    }
+
+    template <size_t I, class Processor>
+    void applyCandidate(Processor& processor, const uint8_t* pos, const size_t from,
+                        const Step& step)
+    {
+        if (step.matcher == I)
         {
-            throw std::runtime_error{"no match - should not happen"};
+            auto match = std::get<I>(m_candidates[from])[step.cls];
+            match.length = step.length;
+            processor.consumeMatch(pos + from, pos + from + step.length, match);
+        }
+        else if constexpr (I + 1 < std::tuple_size_v<std::tuple<Matchers...>>)
+        {
+            applyCandidate<I + 1>(processor, pos, from, step);
         }
     }
 
-private:
+    ParseOptions m_options;
     std::tuple<Matchers...> m_matchers;
+    std::vector<Candidates> m_candidates;
+    std::vector<Step> m_steps;
+    std::vector<Step> m_literalSteps;
+    // the end of every step of the path and whether it is a literal
+    std::vector<std::pair<size_t, bool>> m_path;
+    unsigned int m_threads{1};
+    // matches searched by the threads, from position m_searchedFrom on
+    std::vector<Candidates> m_searched;
+    size_t m_searchedFrom{0};
+    // streaming: the buffered input and the position up to which it is parsed
+    std::vector<uint8_t> m_stream;
+    size_t m_streamPos{0};
+    // compressWithPrefix(): the end of the prefix and the start of the data, and the bytes of the
+    // prefix the matchers were advanced over before
+    std::vector<uint8_t> m_head;
+    size_t m_primedPrefix{0};
 };
 
-} // namespace squeeze
\ No newline at end of file
+// Sets lz to a copy of snapshot, e.g. a configured or primed compressor, to compress with it.
+// Assigning to the compressor of an earlier compression copies the matchers into its memory, in
+// time linear in their windows, instead of allocating them anew.
+template <class Lz> auto restoreCompressor(std::optional<Lz>& lz, const Lz& snapshot) -> Lz&
+{
+    if (lz)
+    {
+        *lz = snapshot;
+    }
+    else
+    {
+        lz.emplace(snapshot);
+    }
+    return *lz;
+}
+
+} // namespace squeeze
\ No newline at end of file
@@ -0,0 +1,61 @@
+#include "TestUtil.h"
+#include <squeeze.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks that copyMatch() produces the same bytes as a byte by byte copy for every short offset,
+// including the periods that are repeated before copying in blocks, and that it writes no further
+// than MatchCopySlack bytes beyond the match.
+
+namespace {
+
+using test::check;
+
+void testCopyMatch()
+{
+    constexpr size_t MaxOffset = 80;
+    constexpr size_t MaxLength = 300;
+    std::mt19937 random{777};
+    std::vector<uint8_t> history(MaxOffset);
+    for (auto& byte : history)
+    {
+        byte = static_cast<uint8_t>(random());
+    }
+
+    for (size_t offset = 1; offset < MaxOffset; ++offset)
+    {
+        for (size_t length = 0; length < MaxLength; ++length)
+        {
+            // the history, the match, its slack and a guard byte
+            std::vector<uint8_t> expected(MaxOffset + length + squeeze::MatchCopySlack + 1, 0xa5);
+            std::copy(history.begin(), history.end(), expected.begin());
+            auto actual = expected;
+            auto* const out = expected.data() + MaxOffset;
+            auto const* const source = out - offset;
+            for (size_t i = 0; i < length; ++i)
+            {
+                out[i] = source[i];
+            }
+            squeeze::copyMatch(actual.data() + MaxOffset, offset, length);
+
+            auto const description =
+                "offset " + std::to_string(offset) + ", length " + std::to_string(length);
+            check(std::equal(expected.begin(), expected.begin() + MaxOffset + length,
+                             actual.begin()),
+                  description);
+            check(actual.back() == 0xa5, description + ", slack");
+        }
+    }
+}
+
+} // namespace
+
+int main()
+{
+    testCopyMatch();
+    return test::failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,113 @@
+#include "TestUtil.h"
+#include <squeeze.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+
+// Checks that matchLength() agrees with a byte by byte comparison for a first mismatch at every
+// offset below 64 and for lengths that end inside an AVX2, SSE2 or 64-bit block. The inputs are
+// allocated with exactly maxLength bytes so that reading past the end is caught by the address
+// sanitizer, and later bytes differ as well so that a wrong byte order in a block is noticed.
+
+namespace {
+
+using test::check;
+
+auto referenceLength(const uint8_t* a, const uint8_t* b, size_t maxLength) -> size_t
+{
+    size_t length{0};
+    while (length < maxLength && a[length] == b[length])
+    {
+        ++length;
+    }
+    return length;
+}
+
+void testMismatches()
+{
+    constexpr size_t MaxMismatch = 64;
+    constexpr size_t MaxLength = 140;
+    std::mt19937 random{4242};
+    for (size_t maxLength = 0; maxLength < MaxLength; ++maxLength)
+    {
+        // MaxMismatch stands for inputs that are equal everywhere
+        for (size_t mismatch = 0; mismatch <= MaxMismatch; ++mismatch)
+        {
+            std::vector<uint8_t> a(maxLength);
+            for (auto& byte : a)
+            {
+                byte = static_cast<uint8_t>(random());
+            }
+            std::vector<uint8_t> b = a;
+            if (mismatch < maxLength && mismatch < MaxMismatch)
+            {
+                b[mismatch] ^= static_cast<uint8_t>(1u << (mismatch % 8));
+                for (size_t i = mismatch + 1; i < maxLength; ++i)
+                {
+                    if (random() % 4 == 0)
+                    {
+                        b[i] ^= static_cast<uint8_t>(1u << (random() % 8));
+                    }
+                }
+            }
+
+            auto const expected = referenceLength(a.data(), b.data(), maxLength);
+            auto const description =
+                std::to_string(maxLength) + " bytes, mismatch at " + std::to_string(mismatch);
+            check(squeeze::matchLength(a.data(), b.data(), maxLength) == expected,
+                  "pointers, " + description);
+            check(squeeze::matchLength(b.data(), a.data(), maxLength) == expected,
+                  "swapped pointers, " + description);
+            check(squeeze::matchLength(reinterpret_cast<const char*>(a.data()),
+                                       reinterpret_cast<const char*>(b.data()),
+                                       maxLength) == expected,
+                  "char pointers, " + description);
+            check(squeeze::matchLength(a.begin(), b.begin(), maxLength) == expected,
+                  "iterators, " + description);
+        }
+    }
+}
+
+void testOverlapping()
+{
+    constexpr size_t Size = 200;
+    std::mt19937 random{99};
+    for (size_t period = 1; period < 70; ++period)
+    {
+        std::vector<uint8_t> data(Size);
+        for (size_t i = 0; i < period; ++i)
+        {
+            data[i] = static_cast<uint8_t>(random());
+        }
+        for (size_t i = period; i < Size; ++i)
+        {
+            data[i] = data[i - period];
+        }
+        // a shift by the period matches up to the end, the other shifts stop somewhere before
+        for (size_t offset = 1; offset < period + 2 && offset < Size; ++offset)
+        {
+            auto const maxLength = Size - offset;
+            auto const expected = referenceLength(data.data() + offset, data.data(), maxLength);
+            check(squeeze::matchLength(data.data() + offset, data.data(), maxLength) == expected,
+                  "period " + std::to_string(period) + ", offset " + std::to_string(offset));
+        }
+    }
+}
+
+} // namespace
+
+int main()
+{
+#if defined(SQUEEZE_TEST_REQUIRE_AVX2)
+    if (!__builtin_cpu_supports("avx2"))
+    {
+        return 77;
+    }
+#endif
+    testMismatches();
+    testOverlapping();
+    return test::failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
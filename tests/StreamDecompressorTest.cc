@@ -0,0 +1,125 @@
+#include "TestUtil.h"
+#include <namco/Lz0103.h>
+#include <namco/Lz80.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdlib>
+#include <functional>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+// Checks that the stream decompressors produce the same data as the one-shot functions, however
+// the compressed data is split, and that they reject data that ends within a token.
+
+namespace {
+
+using test::check;
+
+using Callback = std::function<void(const uint8_t* data, size_t size)>;
+
+template <class Decompressor>
+auto feedInChunks(const std::vector<uint8_t>& compressed, const size_t chunkSize)
+    -> std::vector<uint8_t>
+{
+    std::vector<uint8_t> output;
+    Decompressor decompressor{[&](const uint8_t* data, const size_t size) {
+        output.insert(output.end(), data, data + size);
+    }};
+    test::feedInChunks(compressed, chunkSize, [&](const uint8_t* data, const size_t size) {
+        decompressor.feed(data, size);
+    });
+    decompressor.finish();
+    return output;
+}
+
+template <class Decompressor> auto throwsOnFinish(const std::vector<uint8_t>& compressed) -> bool
+{
+    Decompressor decompressor{[](const uint8_t*, size_t) {}};
+    try
+    {
+        for (auto const byte : compressed)
+        {
+            decompressor.feed(&byte, 1);
+        }
+        decompressor.finish();
+    }
+    catch (const std::runtime_error&)
+    {
+        return true;
+    }
+    return false;
+}
+
+template <class Decompressor, class Compress, class Decompress>
+void testCodec(const std::string& name, const std::vector<uint8_t>& input, Compress compress,
+               Decompress decompress)
+{
+    auto const compressed = compress(input.data(), input.size());
+    auto const expected = decompress(compressed.data(), compressed.size());
+    check(std::ranges::equal(expected, input), name + ", round trip");
+    for (auto const chunkSize : {size_t{1}, size_t{7}, size_t{4099}, compressed.size()})
+    {
+        check(feedInChunks<Decompressor>(compressed, chunkSize) == expected,
+              name + ", chunks of " + std::to_string(chunkSize));
+    }
+
+    // the stream ends with a match, or with the end marker for LZ80; cut off its last byte
+    std::string const repeated = "abcabcabcabcabcabcabcabcabcabcabc";
+    auto truncated = compress(reinterpret_cast<const uint8_t*>(repeated.data()), repeated.size());
+    truncated.pop_back();
+    check(throwsOnFinish<Decompressor>(truncated), name + ", truncated within a token");
+}
+
+// Offsets reach no further back than the window, also when the buffer slides it to the front.
+void testWindow()
+{
+    constexpr size_t WindowLength = 16;
+    size_t received = 0;
+    squeeze::LzStreamDecompressor<true> decompressor{
+        WindowLength, [&](const uint8_t*, const size_t size) { received += size; }};
+    decompressor.reset();
+    // the match would slide the buffer, leaving just the window before it
+    decompressor.emitLiterals(65526, 'x');
+    bool threw = false;
+    try
+    {
+        decompressor.emitMatch(1000, 100);
+    }
+    catch (const std::runtime_error&)
+    {
+        threw = true;
+    }
+    check(threw, "generic, offset beyond the window at a slide");
+    decompressor.emitMatch(WindowLength, 100);
+    decompressor.finish();
+    check(received == 65626, "generic, output size");
+}
+
+} // namespace
+
+int main()
+{
+    using squeeze::CompressionLevel;
+    auto const input = test::makeInput(200000, 54321);
+    testCodec<squeeze::Lz80StreamDecompressor>(
+        "LZ80", input,
+        [](const uint8_t* data, size_t size) {
+            return squeeze::compressLz80(data, size, 32768, CompressionLevel::Fast);
+        },
+        [](const uint8_t* data, size_t size) { return squeeze::decompressLz80(data, size); });
+    testCodec<squeeze::Lz01StreamDecompressor>(
+        "LZ01", input,
+        [](const uint8_t* data, size_t size) {
+            return squeeze::compressLz01(data, size, CompressionLevel::Fast);
+        },
+        [](const uint8_t* data, size_t size) { return squeeze::decompressLz01(data, size); });
+    testCodec<squeeze::Lz03StreamDecompressor>(
+        "LZ03", input,
+        [](const uint8_t* data, size_t size) {
+            return squeeze::compressLz03(data, size, CompressionLevel::Fast);
+        },
+        [](const uint8_t* data, size_t size) { return squeeze::decompressLz03(data, size); });
+    testWindow();
+    return test::failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
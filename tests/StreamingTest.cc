@@ -0,0 +1,63 @@
+#include "TestUtil.h"
+#include <squeeze.h>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <tuple>
+#include <vector>
+
+// Checks that LzCompressor produces the same tokens whether its input is passed to compress() at
+// once or fed in chunks, and that finish() leaves it ready for a new stream.
+
+namespace {
+
+using test::check;
+using test::Token;
+using test::TokenCollector;
+
+template <class Lz>
+auto feedInChunks(Lz& lz, const std::vector<uint8_t>& input, const size_t chunkSize)
+    -> std::vector<Token>
+{
+    TokenCollector collector;
+    test::feedInChunks(input, chunkSize, [&](const uint8_t* data, const size_t size) {
+        lz.feed(data, size, collector);
+    });
+    lz.finish(collector);
+    return collector.tokens;
+}
+
+template <class Matcher>
+void testMatcher(const std::string& name, const std::vector<uint8_t>& input)
+{
+    constexpr size_t WindowSize = 32768;
+    for (auto const& [strategy, strategyName] : test::Strategies)
+    {
+        squeeze::ParseOptions const options{.strategy = strategy};
+        TokenCollector expected;
+        auto lz = test::makeCompressor<Matcher>(options, WindowSize);
+        lz.compress(input.data(), input.size(), expected);
+
+        // one byte, less than a window and more than a window at a time
+        for (auto const chunkSize : {size_t{1}, size_t{1000}, size_t{70000}})
+        {
+            auto const description =
+                name + ", " + strategyName + ", chunks of " + std::to_string(chunkSize);
+            auto lz = test::makeCompressor<Matcher>(options, WindowSize);
+            check(feedInChunks(lz, input, chunkSize) == expected.tokens, description);
+            // the compressor finished the stream and starts over
+            check(feedInChunks(lz, input, 4096) == expected.tokens,
+                  description + ", second stream");
+        }
+    }
+}
+
+} // namespace
+
+int main()
+{
+    auto const input = test::makeInput(150000);
+    testMatcher<squeeze::BinaryTreeMatcher<3, 2>>("BinaryTreeMatcher", input);
+    testMatcher<squeeze::HashChainMatcher<3>>("HashChainMatcher", input);
+    return test::failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
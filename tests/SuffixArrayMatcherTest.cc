@@ -0,0 +1,79 @@
+#include "TestUtil.h"
+#include <squeeze.h>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Checks that SuffixArrayMatcher finds as long a match for every class as an exhaustive search, at
+// every position the parsers search, including those that lazy parsing searches ahead of the ones
+// it advanced over.
+
+namespace {
+
+using test::check;
+
+// Compares every search with one of BruteForceMatcher. Offsets may differ between matches of the
+// same length, so only the lengths are compared, and the offsets are checked to match.
+class CheckedSuffixArrayMatcher : public squeeze::SuffixArrayMatcher<3>
+{
+public:
+    using SuffixArrayMatcher::SuffixArrayMatcher;
+
+    template <class Iterator> bool findMatches(Iterator begin, Iterator end, Iterator pos)
+    {
+        auto const found = SuffixArrayMatcher::findMatches(begin, end, pos);
+        squeeze::BruteForceMatcher<3> reference{windowLength()};
+        for (unsigned int cls = 0; cls < matchClassCount(); ++cls)
+        {
+            reference.configureMatchClass(cls, matchClass(cls));
+        }
+        auto const expected = reference.findMatches(begin, end, pos);
+
+        ++searches;
+        auto agrees = found == expected;
+        for (unsigned int cls = 0; cls < matchClassCount(); ++cls)
+        {
+            auto const& match = matches()[cls];
+            agrees &= match.length == reference.matches()[cls].length;
+            if (match.isValid())
+            {
+                agrees &= matchClass(cls).offset.contains(match.offset) &&
+                          match.offset <= static_cast<size_t>(pos - begin) &&
+                          squeeze::matchLength(pos, pos - match.offset, match.length) ==
+                              match.length;
+            }
+        }
+        mismatches += agrees ? 0 : 1;
+        return found;
+    }
+
+    size_t searches{0};
+    size_t mismatches{0};
+};
+
+void testStrategy(const squeeze::ParseOptions& options, const std::string& name,
+                  const std::vector<uint8_t>& input)
+{
+    constexpr size_t WindowSize = 1024;
+    auto lz = test::makeCompressor<CheckedSuffixArrayMatcher>(options, WindowSize);
+    test::TokenCollector collector;
+    lz.compress(input.data(), input.size(), collector);
+    check(lz.matcher().searches > 0, name + ", searched");
+    check(lz.matcher().mismatches == 0,
+          name + ", " + std::to_string(lz.matcher().mismatches) + " searches differ");
+}
+
+} // namespace
+
+int main()
+{
+    auto const input = test::makeInput(12000, 999);
+    for (auto const& [strategy, strategyName] : test::Strategies)
+    {
+        testStrategy(squeeze::ParseOptions{.strategy = strategy}, strategyName, input);
+    }
+    testStrategy(squeeze::ParseOptions{.strategy = squeeze::ParseStrategy::Lazy, .lazyDepth = 3},
+                 "lazy, depth 3", input);
+    return test::failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <squeeze.h>
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <random>
+#include <string>
+#include <tuple>
+#include <utility>
+#include <vector>
+
+// Scaffolding shared by the tests.
+
+namespace test {
+
+inline int failures = 0;
+
+inline const std::pair<squeeze::ParseStrategy, std::string> Strategies[] = {
+    {squeeze::ParseStrategy::Greedy, "greedy"},
+    {squeeze::ParseStrategy::Lazy, "lazy"},
+    {squeeze::ParseStrategy::Optimal, "optimal"},
+};
+
+inline void check(const bool condition, const std::string& description)
+{
+    if (!condition)
+    {
+        std::cerr << "FAILED: " << description << '\n';
+        ++failures;
+    }
+}
+
+// Words from a small vocabulary with runs of random bytes in between, so that the data holds all
+// kinds of tokens and matches reach across the whole window and beyond it.
+inline auto makeInput(const size_t size, const unsigned int seed = 12345) -> std::vector<uint8_t>
+{
+    std::mt19937 random{seed};
+    std::vector<std::string> words;
+    for (size_t i = 0; i < 400; ++i)
+    {
+        std::string word;
+        for (auto length = 2 + random() % 10; word.size() < length;)
+        {
+            word += static_cast<char>('a' + random() % 26);
+        }
+        words.push_back(word + ' ');
+    }
+
+    std::vector<uint8_t> input;
+    while (input.size() < size)
+    {
+        if (random() % 50 == 0)
+        {
+            for (auto length = random() % 200; length > 0; --length)
+            {
+                input.push_back(static_cast<uint8_t>(random()));
+            }
+        }
+        auto const& word = words[random() % words.size()];
+        input.insert(input.end(), word.begin(), word.end());
+    }
+    input.resize(size);
+    return input;
+}
+
+// A token as (literal byte or match length, match offset, match class); literals have offset 0.
+using Token = std::tuple<size_t, size_t, unsigned int>;
+
+class TokenCollector
+{
+public:
+    void consumeMatch(const uint8_t*, const uint8_t*, const squeeze::Match& match)
+    {
+        tokens.emplace_back(match.length, match.offset, match.cls);
+    }
+
+    void consumeLiteral(const uint8_t* pos)
+    {
+        tokens.emplace_back(*pos, 0, 0);
+    }
+
+    std::vector<Token> tokens;
+};
+
+// A compressor with the match classes of LZ80 for a window of windowSize bytes.
+template <class Matcher>
+auto makeCompressor(const squeeze::ParseOptions& options, const size_t windowSize)
+{
+    squeeze::LzCompressor<Matcher> lz{options, Matcher{windowSize}};
+    lz.matcher().configureMatchClass(0, squeeze::MatchClass{0, {2, 5}, {1, 16}});
+    lz.matcher().configureMatchClass(1, squeeze::MatchClass{1, {3, 18}, {1, 1024}});
+    lz.matcher().configureMatchClass(2, squeeze::MatchClass{2, {4, 131}, {1, windowSize}});
+    return lz;
+}
+
+// Passes the data to feed(data, size) in chunks of chunkSize bytes, the last one possibly shorter.
+template <class Feed>
+void feedInChunks(const std::vector<uint8_t>& data, const size_t chunkSize, Feed&& feed)
+{
+    for (size_t pos = 0; pos < data.size(); pos += chunkSize)
+    {
+        feed(data.data() + pos, std::min(chunkSize, data.size() - pos));
+    }
+}
+
+} // namespace test
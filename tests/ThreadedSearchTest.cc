@@ -0,0 +1,51 @@
+#include "TestUtil.h"
+#include <squeeze.h>
+#include <cstdint>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// Checks that searching matches on several threads ahead of the parse produces the same tokens as
+// searching them on the calling thread, also with chunks so short that matches jump past them.
+
+namespace {
+
+using test::check;
+using test::TokenCollector;
+
+template <class Matcher>
+void testMatcher(const std::string& name, const std::vector<uint8_t>& input)
+{
+    constexpr size_t WindowSize = 2048;
+    for (auto const& [strategy, strategyName] : test::Strategies)
+    {
+        TokenCollector expected;
+        auto lz = test::makeCompressor<Matcher>(squeeze::ParseOptions{.strategy = strategy},
+                                                WindowSize);
+        lz.compress(input.data(), input.size(), expected);
+
+        for (auto const threads : {2u, 3u})
+        {
+            for (auto const chunkLength : {size_t{1}, size_t{7}, size_t{1000}})
+            {
+                squeeze::ParseOptions const options{
+                    .strategy = strategy, .threads = threads, .chunkLength = chunkLength};
+                TokenCollector collector;
+                auto lz = test::makeCompressor<Matcher>(options, WindowSize);
+                lz.compress(input.data(), input.size(), collector);
+                check(collector.tokens == expected.tokens,
+                      name + ", " + strategyName + ", " + std::to_string(threads) +
+                          " threads, chunks of " + std::to_string(chunkLength));
+            }
+        }
+    }
+}
+
+} // namespace
+
+int main()
+{
+    auto const input = test::makeInput(8000);
+    testMatcher<squeeze::HashChainMatcher<3>>("HashChainMatcher", input);
+    return test::failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}